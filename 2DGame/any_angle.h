@@ -0,0 +1,127 @@
+#ifndef ANY_ANGLE_H
+#define ANY_ANGLE_H
+
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include "game_map.h"
+#include "clearance_map.h"
+
+/* Any angle paths over the chunked GameMap.
+
+The searches return one cell per step. string_pull() walks such a path and
+keeps only the cells where it has to turn: from the last kept corner it goes
+as far along the path as it can still see, the first cell it can't see makes
+the cell before it a corner. The result is the list of corners, the target
+included, a unit goes in a straight line from one to the next.
+
+line_of_sight() follows the segment between the centers of two cells one row
+of cells at a time. The cells of a row whose inside the segment crosses must
+be walkable, they are checked as a mask against the walk bits of the chunks
+they are in. Cells the segment only touches in a corner are not checked, the
+same corner cutting the searches allow for diagonal moves. For units of size
+over 1 the cells must have a clearance of at least the size instead, the unit
+being on the top left cell of it's square as in grid_search_t. */
+
+/* mask of the bits lo..hi */
+uint32_t span_mask(int lo, int hi) {
+	uint32_t upper = hi >= CHK_SZ - 1 ? ~0u : (1u << (hi + 1)) - 1;
+	return upper & ~((1u << lo) - 1);
+}
+
+/* true if the cells (i, j0..j1) can all be walked */
+bool span_clear(const GameMap &map, int i, int j0, int j1,
+		const clearance_map_t *clearance = NULL, int size = 1)
+{
+	if (size > 1) {
+		if (!clearance)
+			return false;
+		for (int j = j0; j <= j1; j++)
+			if (!clearance->fits(i, j, size))
+				return false;
+		return true;
+	}
+	int row = i >> CHK_SHIFT;
+	int li = i & (CHK_SZ - 1);
+	for (int col = j0 >> CHK_SHIFT; col <= j1 >> CHK_SHIFT; col++) {
+		auto chunk = map.find_chunk(row, col);
+		if (!chunk)
+			return false;
+		int lo = std::max(j0 - col * CHK_SZ, 0);
+		int hi = std::min(j1 - col * CHK_SZ, CHK_SZ - 1);
+		uint32_t mask = span_mask(lo, hi);
+		if ((chunk->walk[li] & mask) != mask)
+			return false;
+	}
+	return true;
+}
+
+/* true if a unit can go in a straight line from cell a to cell b */
+bool line_of_sight(const GameMap &map, Math::Point2i a, Math::Point2i b,
+		const clearance_map_t *clearance = NULL, int size = 1)
+{
+	if (a.x > b.x)
+		std::swap(a, b);
+	int64_t di = b.x - a.x;
+	int64_t dj = b.y - a.y;
+	if (di == 0)
+		return span_clear(map, a.x, std::min(a.y, b.y), std::max(a.y, b.y),
+				clearance, size);
+
+	/* in half cells, the segment goes from 2a + 1 to 2b + 1. Along it the
+	column is (2 * a.y + 1) / 2 + (I - 2 * a.x - 1) * dj / (2 * di) for the
+	doubled row I, so columns are kept as numerators over 2 * di */
+	int64_t den = 2 * di;
+	auto column = [&](int64_t I) {
+		return (2 * a.y + 1) * di + (I - 2 * a.x - 1) * dj;
+	};
+	auto floor_div = [](int64_t n, int64_t d) {
+		return n >= 0 ? n / d : -((-n + d - 1) / d);
+	};
+	for (int64_t i = a.x; i <= b.x; i++) {
+		int64_t n0 = column(std::max(2 * i, 2 * int64_t(a.x) + 1));
+		int64_t n1 = column(std::min(2 * i + 2, 2 * int64_t(b.x) + 1));
+		if (n0 > n1)
+			std::swap(n0, n1);
+		int64_t j0 = floor_div(n0, den);
+		int64_t j1 = n0 == n1 ? j0 : floor_div(n1 + den - 1, den) - 1;
+		if (!span_clear(map, i, j0, j1, clearance, size))
+			return false;
+	}
+	return true;
+}
+
+/* Replaces path, the cells after start as get_path() gives them, with the
+corners of the any angle path. The last cell is always kept. */
+void string_pull(const GameMap &map, Math::Point2i start,
+		std::vector<Math::Point2i> &path,
+		const clearance_map_t *clearance = NULL, int size = 1)
+{
+	if (path.size() < 2)
+		return ;
+	std::vector<Math::Point2i> corners;
+	Math::Point2i anchor = start;
+	for (size_t k = 1; k < path.size(); k++) {
+		if (line_of_sight(map, anchor, path[k], clearance, size))
+			continue ;
+		anchor = path[k - 1];
+		corners.push_back(anchor);
+	}
+	corners.push_back(path.back());
+	path.swap(corners);
+}
+
+/* length of the path from start in the cost units of the searches, 10 per
+straight cell */
+int path_length(Math::Point2i start,
+		const std::vector<Math::Point2i> &path)
+{
+	double len = 0;
+	for (auto &&p : path) {
+		len += std::hypot(p.x - start.x, p.y - start.y);
+		start = p;
+	}
+	return int(std::lround(len * 10));
+}
+
+#endif
@@ -0,0 +1,59 @@
+#include "Dbg.h"
+#include "MathLib.h"
+#include "pathfinding.h"
+#include "test_pathfinding.h"
+
+/* Headless pathfinding benchmark, no window is opened.
+	usage: ./bench [results.csv] [random queries] [map.json]
+
+Runs the map from map.json, a generated maze and a generated open field,
+prints a table and writes the rows as csv (bench.csv by default). Exits with 2
+if a planner's path costs are out of their bounds, see check_rows(). */
+
+void *operator new (size_t size) {
+	bench_alloc_bytes += size;
+	if (void *ptr = malloc(size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete (void *ptr) noexcept {
+	free(ptr);
+}
+
+void operator delete (void *ptr, size_t) noexcept {
+	free(ptr);
+}
+
+int main (int argc, char const *argv[])
+{
+	std::string out_file = argc > 1 ? argv[1] : "bench.csv";
+	int count = argc > 2 ? atoi(argv[2]) : 500;
+	std::string map_file = argc > 3 ? argv[3] : "map.json";
+
+	std::vector<bench_row_t> rows;
+	auto add = [&](const std::vector<bench_row_t> &more) {
+		rows.insert(rows.end(), more.begin(), more.end());
+	};
+
+	GameMap map(map_file);
+	add(bench_scenario("map", map, count));
+
+	GameMap maze;
+	generate_maze(maze, 4, 4, 1);
+	add(bench_scenario("maze", maze, count));
+
+	GameMap field;
+	generate_open_field(field, 4, 4, 20, 1);
+	add(bench_scenario("field", field, count));
+
+	print_rows(rows);
+	FILE *out = fopen(out_file.c_str(), "w");
+	if (!out) {
+		printf("can't write %s\n", out_file.c_str());
+		return 1;
+	}
+	rows_to_csv(out, rows);
+	fclose(out);
+	return check_rows(rows) ? 0 : 2;
+}
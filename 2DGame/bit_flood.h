@@ -0,0 +1,181 @@
+#ifndef BIT_FLOOD_H
+#define BIT_FLOOD_H
+
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdint>
+#include "game_map.h"
+
+/* Breadth first flood fill over the walk bits of the chunked GameMap.
+
+The flood keeps, for every chunk it reached, the row masks of the cells seen so
+far and of the current frontier. One BFS layer grows the whole frontier at once:
+each frontier row is or-ed with itself shifted left and right, then spread to
+the rows above and below and and-ed with the walk bits, so a chunk costs a few
+operations per row instead of a hash lookup per cell. Bits that leave a chunk
+go to the same row or column of the neighbour chunk. The moves are the 8
+neighbour ones the searches use, the layers are the BFS distances.
+
+Chunks missing from the map are walls. */
+
+struct bit_flood_t {
+	struct chunk_t {
+		const GameMap::chunk_t *src;
+		uint32_t seen[CHK_SZ];
+		uint32_t front[CHK_SZ];
+		uint32_t next[CHK_SZ];
+		int lo, hi;
+		int front_lo, front_hi;
+	};
+
+	GameMap &map;
+	std::unordered_map<int64_t, chunk_t> data;
+	std::vector<int64_t> touched;
+	int layers = 0;
+
+	bit_flood_t(GameMap &map) : map(map) {}
+
+	static int64_t chunk_key(int row, int col) {
+		return (int64_t(row) << 32) | uint32_t(col);
+	}
+
+	static int floor_div(int a) {
+		return a >= 0 ? a / CHK_SZ : -((-a + CHK_SZ - 1) / CHK_SZ);
+	}
+
+	/* NULL if the chunk is not in the map */
+	chunk_t *get(int row, int col) {
+		auto key = chunk_key(row, col);
+		auto it = data.find(key);
+		if (it != data.end())
+			return it->second.src ? &it->second : NULL;
+		auto &chunk = data[key];
+		chunk.src = map.find_chunk(row, col);
+		std::fill(chunk.seen, chunk.seen + CHK_SZ, 0);
+		std::fill(chunk.front, chunk.front + CHK_SZ, 0);
+		std::fill(chunk.next, chunk.next + CHK_SZ, 0);
+		chunk.lo = CHK_SZ;
+		chunk.hi = -1;
+		return chunk.src ? &chunk : NULL;
+	}
+
+	/* ors bits into row r of the next layer of chunk (row, col), r may be one
+	past the chunk. Chunks are queued in touched the first time they get bits
+	and only the rows between lo and hi are looked at. */
+	void spread(int row, int col, int r, uint32_t bits) {
+		if (!bits)
+			return ;
+		if (r < 0) {
+			row--;
+			r += CHK_SZ;
+		}
+		else if (r >= CHK_SZ) {
+			row++;
+			r -= CHK_SZ;
+		}
+		auto chunk = get(row, col);
+		if (!chunk)
+			return ;
+		if (chunk->lo > chunk->hi)
+			touched.push_back(chunk_key(row, col));
+		chunk->next[r] |= bits;
+		chunk->lo = std::min(chunk->lo, r);
+		chunk->hi = std::max(chunk->hi, r);
+	}
+
+	/* Floods from (i, j), calls layer_fn(i, j, dist) for every reached cell,
+	the start included, in BFS order. Returns the number of reached cells. */
+	template <typename layer_fn_t>
+	int flood(int i, int j, layer_fn_t layer_fn) {
+		data.clear();
+		touched.clear();
+		layers = 0;
+		int row = floor_div(i);
+		int col = floor_div(j);
+		auto start = get(row, col);
+		if (!start || !start->src->walkable(i - row * CHK_SZ, j - col * CHK_SZ))
+			return 0;
+		spread(row, col, i - row * CHK_SZ, 1u << (j - col * CHK_SZ));
+
+		int count = 0;
+		std::vector<chunk_t *> active;
+		std::vector<int64_t> keys;
+		while (true) {
+			/* the next layer is what was spread and not seen yet */
+			active.clear();
+			keys.clear();
+			for (auto key : touched) {
+				auto &chunk = data[key];
+				uint32_t any = 0;
+				for (int r = chunk.lo; r <= chunk.hi; r++) {
+					uint32_t bits = chunk.next[r] & chunk.src->walk[r] &
+							~chunk.seen[r];
+					chunk.next[r] = 0;
+					chunk.front[r] = bits;
+					chunk.seen[r] |= bits;
+					any |= bits;
+				}
+				chunk.front_lo = chunk.lo;
+				chunk.front_hi = chunk.hi;
+				chunk.lo = CHK_SZ;
+				chunk.hi = -1;
+				if (any) {
+					active.push_back(&chunk);
+					keys.push_back(key);
+				}
+			}
+			touched.clear();
+			if (active.empty())
+				break ;
+
+			for (int k = 0; k < active.size(); k++) {
+				auto &chunk = *active[k];
+				int crow = keys[k] >> 32;
+				int ccol = int32_t(keys[k]);
+				for (int r = chunk.front_lo; r <= chunk.front_hi; r++)
+					for (uint32_t bits = chunk.front[r]; bits; bits &= bits - 1) {
+						int c = __builtin_ctz(bits);
+						layer_fn(crow * CHK_SZ + r, ccol * CHK_SZ + c, layers);
+						count++;
+					}
+			}
+			layers++;
+
+			for (int k = 0; k < active.size(); k++) {
+				auto &chunk = *active[k];
+				int crow = keys[k] >> 32;
+				int ccol = int32_t(keys[k]);
+				for (int r = chunk.front_lo; r <= chunk.front_hi; r++) {
+					uint32_t f = chunk.front[r];
+					if (!f)
+						continue ;
+					uint32_t mid = f | (f << 1) | (f >> 1);
+					uint32_t left = (f & 1) << (CHK_SZ - 1);
+					uint32_t right = f >> (CHK_SZ - 1);
+					for (int dr = -1; dr <= 1; dr++) {
+						spread(crow, ccol, r + dr, mid);
+						spread(crow, ccol - 1, r + dr, left);
+						spread(crow, ccol + 1, r + dr, right);
+					}
+				}
+			}
+		}
+		return count;
+	}
+
+	int flood(int i, int j) {
+		return flood(i, j, [](int, int, int) {});
+	}
+
+	bool reached(int i, int j) const {
+		int row = floor_div(i);
+		int col = floor_div(j);
+		auto it = data.find(chunk_key(row, col));
+		if (it == data.end() || !it->second.src)
+			return false;
+		return (it->second.seen[i - row * CHK_SZ] >> (j - col * CHK_SZ)) & 1;
+	}
+};
+
+#endif
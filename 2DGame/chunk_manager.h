@@ -0,0 +1,272 @@
+#ifndef CHUNK_MANAGER_H
+#define CHUNK_MANAGER_H
+
+#include <vector>
+#include <fstream>
+#include <deque>
+#include <algorithm>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "game_map.h"
+#include "world_file.h"
+
+/* Streams the chunks of a GameMap in and out of memory.
+
+Nothing is read for a chunk before it is wanted. With a world file
+(world_file.h) the index of the file is searched when a chunk is asked for, the
+file is mapped so only the pages of the index that are searched are read. A
+map.json has to be parsed whole, only the sorted keys of it's list are kept and
+the file name of a chunk is taken from the parsed list when it is requested.
+State is only kept for the chunks that were requested or are resident, so
+startup and memory don't grow with the size of the world. The chunks are loaded
+by a background thread when they get within radius chunks of one of the focus
+points given to update() (the camera and the active units). Finished loads are
+moved in the map on the main thread, by update(), so the map is never touched
+by the loader.
+
+Every resident chunk remembers the last update it was wanted in. When the
+resident chunks take more than the memory budget the ones that were wanted the
+longest ago are evicted, chunks inside the radius of a focus point never are.
+
+update() returns the chunks that were added or removed, the caller passes them
+to the update_chunk() of it's clearance, connectivity and hpa layers and resets
+it's search engines. A chunk that is listed but not resident (state() is
+LOADING or UNLOADED) is what searches report as not_resident, a chunk that is
+not listed at all is a wall. */
+
+struct chunk_manager_t {
+	enum state_t {
+		MISSING,
+		UNLOADED,
+		LOADING,
+		RESIDENT,
+	};
+
+	constexpr static int RADIUS = 2;
+	constexpr static size_t DEFAULT_BUDGET = 64 * sizeof(GameMap::chunk_t);
+
+	struct entry_t {
+		state_t state = UNLOADED;
+		uint64_t used = 0;
+	};
+
+	struct loaded_t {
+		GameMap::key_t key;
+		GameMap::chunk_t chunk;
+	};
+
+	GameMap &map;
+	world_file_t world;
+	/* without a world file, the chunks of map.json and their keys sorted,
+	with their place in the list */
+	nlohmann::json json_chunks;
+	std::vector<std::pair<int64_t, int>> json_keys;
+	/* the chunks that were requested or are resident */
+	std::unordered_map<int64_t, entry_t> entries;
+	size_t budget;
+	int radius = RADIUS;
+	size_t resident = 0;
+	uint64_t frame = 0;
+
+	std::mutex mu;
+	std::condition_variable cv;
+	std::deque<std::pair<GameMap::key_t, std::string>> requests;
+	std::vector<loaded_t> done;
+	bool stop = false;
+	std::thread loader;
+
+	chunk_manager_t(GameMap &map, std::string map_file,
+			size_t budget = DEFAULT_BUDGET)
+	: map(map), budget(budget)
+	{
+		read_catalog(map_file);
+		loader = std::thread([this]{ load_loop(); });
+	}
+
+	void read_catalog(std::string map_file) {
+		if (world_file_t::is_world(map_file) && world.open(map_file))
+			return ;
+
+		using namespace nlohmann;
+		std::ifstream file(map_file);
+		json jMap;
+		file >> jMap;
+
+		json_chunks = std::move(jMap["chunks"]);
+		for (int k = 0; k < json_chunks.size(); k++) {
+			int row = json_chunks[k]["row"];
+			int col = json_chunks[k]["col"];
+			json_keys.push_back({chunk_key(row, col), k});
+		}
+		std::sort(json_keys.begin(), json_keys.end());
+	}
+
+	/* place of the chunk in the list of map.json, -1 if it's not there */
+	int json_find(int row, int col) const {
+		auto key = chunk_key(row, col);
+		auto it = std::lower_bound(json_keys.begin(), json_keys.end(),
+				std::make_pair(key, INT_MIN));
+		return it != json_keys.end() && it->first == key ? it->second : -1;
+	}
+
+	/* true if the world has the chunk, resident or not */
+	bool listed(int row, int col) const {
+		if (world.is_open())
+			return world.find(row, col) != NULL;
+		return json_find(row, col) >= 0;
+	}
+
+	/* the entry of a listed chunk, made if the chunk had none, NULL if the
+	chunk is not listed */
+	entry_t *entry(int row, int col) {
+		auto key = chunk_key(row, col);
+		auto it = entries.find(key);
+		if (it != entries.end())
+			return &it->second;
+		if (!listed(row, col))
+			return NULL;
+		return &entries[key];
+	}
+
+	~chunk_manager_t() {
+		{
+			std::lock_guard<std::mutex> lock(mu);
+			stop = true;
+		}
+		cv.notify_all();
+		loader.join();
+	}
+
+	static int64_t chunk_key(int row, int col) {
+		return int64_t(uint64_t(uint32_t(row)) << 32 | uint32_t(col));
+	}
+
+	state_t state(int row, int col) const {
+		auto it = entries.find(chunk_key(row, col));
+		if (it != entries.end())
+			return it->second.state;
+		return listed(row, col) ? UNLOADED : MISSING;
+	}
+
+	/* true if the chunk is listed in the map but is not in memory yet */
+	bool pending(int row, int col) const {
+		auto s = state(row, col);
+		return s == UNLOADED || s == LOADING;
+	}
+
+	void load_loop() {
+		while (true) {
+			std::pair<GameMap::key_t, std::string> req;
+			{
+				std::unique_lock<std::mutex> lock(mu);
+				cv.wait(lock, [&]{ return stop || requests.size(); });
+				if (stop)
+					return ;
+				req = requests.front();
+				requests.pop_front();
+			}
+			loaded_t res{req.first};
+			if (world.is_open())
+				world.load_chunk(req.first.x, req.first.y, res.chunk);
+			else
+				res.chunk = GameMap::load_chunk(req.second);
+			std::lock_guard<std::mutex> lock(mu);
+			done.push_back(res);
+		}
+	}
+
+	/* queues the load of a listed chunk, does nothing if it is already
+	resident or loading */
+	void request(int row, int col) {
+		auto e = entry(row, col);
+		if (!e || e->state != UNLOADED)
+			return ;
+		e->state = LOADING;
+		std::string filename;
+		if (!world.is_open())
+			filename = json_chunks[json_find(row, col)]["filename"];
+		{
+			std::lock_guard<std::mutex> lock(mu);
+			requests.push_back({GameMap::key_t(row, col), filename});
+		}
+		cv.notify_one();
+	}
+
+	/* focus holds cells (i, j), returns the chunks that were added to or
+	removed from the map */
+	std::vector<GameMap::key_t> update(const std::vector<Math::Point2i> &focus) {
+		std::vector<GameMap::key_t> changed;
+		frame++;
+		for (auto &&f : focus) {
+			int row = f.x >> CHK_SHIFT;
+			int col = f.y >> CHK_SHIFT;
+			for (int r = row - radius; r <= row + radius; r++)
+				for (int c = col - radius; c <= col + radius; c++) {
+					auto e = entry(r, c);
+					if (!e)
+						continue ;
+					e->used = frame;
+					request(r, c);
+				}
+		}
+
+		std::vector<loaded_t> loaded;
+		{
+			std::lock_guard<std::mutex> lock(mu);
+			loaded.swap(done);
+		}
+		for (auto &&res : loaded) {
+			auto &entry = entries[chunk_key(res.key.x, res.key.y)];
+			map.add_chunk(res.key.x, res.key.y) = res.chunk;
+			entry.state = RESIDENT;
+			resident += sizeof(GameMap::chunk_t);
+			changed.push_back(res.key);
+		}
+		evict(changed);
+		return changed;
+	}
+
+	/* drops the least recently wanted chunks until the budget is met */
+	void evict(std::vector<GameMap::key_t> &changed) {
+		if (resident <= budget)
+			return ;
+		std::vector<std::pair<uint64_t, int64_t>> cold;
+		for (auto &&[key, entry] : entries)
+			if (entry.state == RESIDENT && entry.used != frame)
+				cold.push_back({entry.used, key});
+		std::sort(cold.begin(), cold.end());
+		for (auto &&[used, key] : cold) {
+			if (resident <= budget)
+				break ;
+			int row = int32_t(key >> 32);
+			int col = int32_t(key);
+			map.remove_chunk(row, col);
+			entries.erase(key);
+			resident -= sizeof(GameMap::chunk_t);
+			changed.push_back(GameMap::key_t(row, col));
+		}
+	}
+
+	/* blocks until the chunks around focus are resident, for startup and
+	headless use */
+	std::vector<GameMap::key_t> load_now(
+			const std::vector<Math::Point2i> &focus)
+	{
+		std::vector<GameMap::key_t> changed;
+		while (true) {
+			auto more = update(focus);
+			changed.insert(changed.end(), more.begin(), more.end());
+			bool waiting = false;
+			for (auto &&[key, entry] : entries)
+				waiting |= entry.state == LOADING;
+			if (!waiting)
+				return changed;
+			std::this_thread::yield();
+		}
+	}
+};
+
+#endif
@@ -0,0 +1,114 @@
+#ifndef CLEARANCE_MAP_H
+#define CLEARANCE_MAP_H
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include "game_map.h"
+
+/* Clearance layer for the chunked GameMap.
+
+For every cell it keeps the side of the largest square of walkable cells that
+has the cell as it's top left corner (lowest i and j), capped at MAX_CLEARANCE.
+A unit of size n standing on a cell covers the n x n square starting there, so
+it fits if the clearance of the cell is at least n.
+
+A cell only depends on the cells below and to the right of it, so a chunk is
+filled from it's last cell using the chunks below and to the right. Values are
+capped under CHK_SZ, so a change inside a chunk can only reach the chunk itself
+and the ones above, to the left and above-left of it, update_chunk() redoes
+exactly those. Chunks missing from the map are walls. */
+
+struct clearance_map_t {
+	constexpr static int MAX_CLEARANCE = 8;
+	static_assert(MAX_CLEARANCE < CHK_SZ, "clearance must stay in one chunk");
+
+	struct chunk_t {
+		uint8_t c[CHK_SZ][CHK_SZ];
+	};
+
+	GameMap &map;
+	std::unordered_map<int64_t, chunk_t> data;
+
+	clearance_map_t(GameMap &map) : map(map) {
+		build();
+	}
+
+	static int64_t chunk_key(int row, int col) {
+		return (int64_t(row) << 32) | uint32_t(col);
+	}
+
+	static int floor_div(int a) {
+		return a >= 0 ? a / CHK_SZ : -((-a + CHK_SZ - 1) / CHK_SZ);
+	}
+
+	/* chunks are done bottom up and right to left, so the ones a chunk
+	depends on are always ready */
+	void build() {
+		data.clear();
+		std::vector<GameMap::key_t> keys;
+		for (auto &&chunk : map.data)
+			keys.push_back(chunk.first);
+		std::sort(keys.begin(), keys.end(), [](auto &a, auto &b) {
+			return a.x != b.x ? a.x > b.x : a.y > b.y;
+		});
+		for (auto &&key : keys)
+			compute_chunk(key.x, key.y);
+	}
+
+	const chunk_t *get_chunk(int row, int col) const {
+		auto it = data.find(chunk_key(row, col));
+		return it == data.end() ? NULL : &it->second;
+	}
+
+	int at(int i, int j) const {
+		int row = floor_div(i);
+		int col = floor_div(j);
+		auto chunk = get_chunk(row, col);
+		if (!chunk)
+			return 0;
+		return chunk->c[i - row * CHK_SZ][j - col * CHK_SZ];
+	}
+
+	bool fits(int i, int j, int size) const {
+		return at(i, j) >= size;
+	}
+
+	void compute_chunk(int row, int col) {
+		auto chunk = map.find_chunk(row, col);
+		if (!chunk) {
+			data.erase(chunk_key(row, col));
+			return ;
+		}
+		auto &src = *chunk;
+		auto &dst = data[chunk_key(row, col)];
+		auto get = [&](int li, int lj) -> int {
+			if (li < CHK_SZ && lj < CHK_SZ)
+				return dst.c[li][lj];
+			return at(row * CHK_SZ + li, col * CHK_SZ + lj);
+		};
+
+		for (int li = CHK_SZ - 1; li >= 0; li--)
+			for (int lj = CHK_SZ - 1; lj >= 0; lj--) {
+				if (src.m[li][lj] != '.') {
+					dst.c[li][lj] = 0;
+					continue ;
+				}
+				int c = std::min({get(li + 1, lj), get(li, lj + 1),
+						get(li + 1, lj + 1)}) + 1;
+				dst.c[li][lj] = std::min(c, MAX_CLEARANCE);
+			}
+	}
+
+	/* call after the cells of a chunk changed or the chunk was added or
+	removed from the map */
+	void update_chunk(int row, int col) {
+		compute_chunk(row, col);
+		compute_chunk(row, col - 1);
+		compute_chunk(row - 1, col);
+		compute_chunk(row - 1, col - 1);
+	}
+};
+
+#endif
@@ -0,0 +1,285 @@
+#ifndef CONNECTIVITY_H
+#define CONNECTIVITY_H
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include "game_map.h"
+#include "world_file.h"
+
+/* Connected components of the walkable cells of the chunked GameMap.
+
+Every chunk labels it's own components, with the same 8 neighbour moves the
+searches use. Each chunk also keeps the links between it's components and the
+components of the neighbour chunks that come after it (greater row, or same
+row and greater column), so every border is stored once. The global components
+are a union-find over all the chunk components, rebuilt from the stored links.
+
+When the cells of a chunk change only that chunk is labelled again and only
+the borders touching it are linked again, then the union-find is rebuilt, which
+only walks the links, not the cells. Chunks missing from the map are walls.
+
+With a world file that has the labels layer, chunks whose walk bits are still
+the ones in the file take their labels from it instead of labelling again. */
+
+struct connectivity_t {
+	constexpr static int NONE = -1;
+	constexpr static int MAX_REDIRECT = 64;
+
+	struct link_t {
+		int64_t other;
+		int a;
+		int b;
+
+		bool operator < (const link_t& oth) const {
+			if (other != oth.other)
+				return other < oth.other;
+			return a != oth.a ? a < oth.a : b < oth.b;
+		}
+
+		bool operator == (const link_t& oth) const {
+			return other == oth.other && a == oth.a && b == oth.b;
+		}
+	};
+
+	struct chunk_t {
+		int16_t label[CHK_SZ][CHK_SZ];
+		int count = 0;
+		int base = 0;
+		std::vector<link_t> links;
+	};
+
+	GameMap &map;
+	const world_file_t *world;
+	std::unordered_map<int64_t, chunk_t> data;
+	std::vector<int> parent;
+
+	connectivity_t(GameMap &map, const world_file_t *world = NULL)
+	: map(map), world(world) {
+		build();
+	}
+
+	static int64_t chunk_key(int row, int col) {
+		return (int64_t(row) << 32) | uint32_t(col);
+	}
+
+	static int floor_div(int a) {
+		return a >= 0 ? a / CHK_SZ : -((-a + CHK_SZ - 1) / CHK_SZ);
+	}
+
+	void build() {
+		data.clear();
+		for (auto &&chunk : map.data)
+			label_chunk(chunk.first.x, chunk.first.y);
+		for (auto &&chunk : map.data)
+			link_chunk(chunk.first.x, chunk.first.y);
+		rebuild();
+	}
+
+	/* call after the cells of a chunk changed or the chunk was added or
+	removed from the map */
+	void update_chunk(int row, int col) {
+		label_chunk(row, col);
+		link_chunk(row, col);
+		link_chunk(row, col - 1);
+		link_chunk(row - 1, col - 1);
+		link_chunk(row - 1, col);
+		link_chunk(row - 1, col + 1);
+		rebuild();
+	}
+
+	int local_label(int i, int j) const {
+		int row = floor_div(i);
+		int col = floor_div(j);
+		auto it = data.find(chunk_key(row, col));
+		if (it == data.end())
+			return NONE;
+		return it->second.label[i - row * CHK_SZ][j - col * CHK_SZ];
+	}
+
+	void label_chunk(int row, int col) {
+		auto chunk = map.find_chunk(row, col);
+		if (!chunk) {
+			data.erase(chunk_key(row, col));
+			return ;
+		}
+		auto &src = *chunk;
+		auto &dst = data[chunk_key(row, col)];
+		if (load_labels(row, col, src, dst))
+			return ;
+		for (auto &&line : dst.label)
+			std::fill(line, line + CHK_SZ, NONE);
+		dst.count = 0;
+
+		std::vector<int> stack;
+		for (int si = 0; si < CHK_SZ; si++)
+			for (int sj = 0; sj < CHK_SZ; sj++) {
+				if (src.m[si][sj] != '.' || dst.label[si][sj] != NONE)
+					continue ;
+				int comp = dst.count++;
+				dst.label[si][sj] = comp;
+				stack.push_back(si * CHK_SZ + sj);
+				while (stack.size()) {
+					int li = stack.back() / CHK_SZ;
+					int lj = stack.back() % CHK_SZ;
+					stack.pop_back();
+					for (int di = -1; di <= 1; di++)
+						for (int dj = -1; dj <= 1; dj++) {
+							int ni = li + di;
+							int nj = lj + dj;
+							if (ni < 0 || nj < 0 || ni >= CHK_SZ || nj >= CHK_SZ)
+								continue ;
+							if (src.m[ni][nj] != '.' ||
+									dst.label[ni][nj] != NONE)
+								continue ;
+							dst.label[ni][nj] = comp;
+							stack.push_back(ni * CHK_SZ + nj);
+						}
+				}
+			}
+	}
+
+	bool load_labels(int row, int col, const GameMap::chunk_t &src,
+			chunk_t &dst)
+	{
+		auto walk = world ? world->walk_bits(row, col) : NULL;
+		auto labels = world ? world->labels(row, col) : NULL;
+		if (!walk || !labels || memcmp(walk, src.walk, sizeof(src.walk)))
+			return false;
+		memcpy(dst.label, labels, sizeof(dst.label));
+		dst.count = 0;
+		for (auto &&line : dst.label)
+			for (auto &&l : line)
+				dst.count = std::max(dst.count, l + 1);
+		return true;
+	}
+
+	/* links of the border cells of the chunk with the chunks after it */
+	void link_chunk(int row, int col) {
+		auto it = data.find(chunk_key(row, col));
+		if (it == data.end())
+			return ;
+		auto &chunk = it->second;
+		chunk.links.clear();
+		for (int li = 0; li < CHK_SZ; li++)
+			for (int lj = 0; lj < CHK_SZ; lj++) {
+				bool border = li == 0 || lj == 0 ||
+						li == CHK_SZ - 1 || lj == CHK_SZ - 1;
+				if (!border || chunk.label[li][lj] == NONE)
+					continue ;
+				for (int di = -1; di <= 1; di++)
+					for (int dj = -1; dj <= 1; dj++) {
+						int ni = row * CHK_SZ + li + di;
+						int nj = col * CHK_SZ + lj + dj;
+						int nrow = floor_div(ni);
+						int ncol = floor_div(nj);
+						if (nrow < row || (nrow == row && ncol <= col))
+							continue ;
+						int lb = local_label(ni, nj);
+						if (lb == NONE)
+							continue ;
+						chunk.links.push_back({chunk_key(nrow, ncol),
+								chunk.label[li][lj], lb});
+					}
+			}
+		std::sort(chunk.links.begin(), chunk.links.end());
+		chunk.links.erase(std::unique(chunk.links.begin(), chunk.links.end()),
+				chunk.links.end());
+	}
+
+	int find(int a) const {
+		while (parent[a] != a)
+			a = parent[a];
+		return a;
+	}
+
+	void rebuild() {
+		int total = 0;
+		for (auto &&chunk : data) {
+			chunk.second.base = total;
+			total += chunk.second.count;
+		}
+		parent.resize(total);
+		for (int i = 0; i < total; i++)
+			parent[i] = i;
+
+		auto root = [&](int a) {
+			while (parent[a] != a) {
+				parent[a] = parent[parent[a]];
+				a = parent[a];
+			}
+			return a;
+		};
+		for (auto &&chunk : data)
+			for (auto &&link : chunk.second.links) {
+				auto other = data.find(link.other);
+				if (other == data.end())
+					continue ;
+				int a = root(chunk.second.base + link.a);
+				int b = root(other->second.base + link.b);
+				if (a != b)
+					parent[std::max(a, b)] = std::min(a, b);
+			}
+		for (int i = 0; i < total; i++)
+			parent[i] = root(i);
+	}
+
+	/* global component of the cell, NONE for walls */
+	int component(int i, int j) const {
+		int row = floor_div(i);
+		int col = floor_div(j);
+		auto it = data.find(chunk_key(row, col));
+		if (it == data.end())
+			return NONE;
+		int l = it->second.label[i - row * CHK_SZ][j - col * CHK_SZ];
+		return l == NONE ? NONE : find(it->second.base + l);
+	}
+
+	bool reachable(int si, int sj, int ti, int tj) const {
+		int comp = component(si, sj);
+		return comp != NONE && comp == component(ti, tj);
+	}
+
+	/* The reachable cell closest to (ti, tj) in octile distance, looked up in
+	growing squares around it, at most MAX_REDIRECT away. A cell on square r is
+	at least 10 * r away, so the squares after the first hit are still looked
+	at while that can beat it. Returns false if there is none */
+	bool nearest_reachable(int si, int sj, int ti, int tj,
+			int &ri, int &rj) const
+	{
+		int comp = component(si, sj);
+		if (comp == NONE)
+			return false;
+		if (component(ti, tj) == comp) {
+			ri = ti;
+			rj = tj;
+			return true;
+		}
+		int best = -1;
+		for (int r = 1; r <= MAX_REDIRECT && (best < 0 || 10 * r < best);
+				r++)
+		{
+			for (int i = ti - r; i <= ti + r; i++)
+				for (int j = tj - r; j <= tj + r;
+						j += (i == ti - r || i == ti + r) ? 1 : 2 * r)
+				{
+					if (component(i, j) != comp)
+						continue ;
+					int di = abs(i - ti);
+					int dj = abs(j - tj);
+					int d = std::min(di, dj) * 14 + abs(di - dj) * 10;
+					if (best < 0 || d < best) {
+						best = d;
+						ri = i;
+						rj = j;
+					}
+				}
+		}
+		return best >= 0;
+	}
+};
+
+#endif
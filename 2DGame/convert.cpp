@@ -0,0 +1,35 @@
+#include "Dbg.h"
+#include "MathLib.h"
+#include "game_map.h"
+#include "connectivity.h"
+#include "world_file.h"
+
+/* Converts a map.json and it's chunk files to a world file.
+	usage: ./convert [map.json] [world.bin]
+
+The world file has the walk bits and the connectivity labels of every chunk,
+chunk_manager_t and connectivity_t use them when they are given the file. */
+
+int main (int argc, char const *argv[])
+{
+	std::string map_file = argc > 1 ? argv[1] : "map.json";
+	std::string world_file = argc > 2 ? argv[2] : "world.bin";
+
+	GameMap map(map_file);
+	connectivity_t connectivity(map);
+	bool ok = world_file_t::write(map, world_file,
+			world_file_t::WALK_BITS | world_file_t::LABELS,
+			[&](int row, int col, int16_t *labels) {
+				auto &chunk = connectivity.data[connectivity.chunk_key(row, col)];
+				memcpy(labels, chunk.label, sizeof(chunk.label));
+			});
+	if (!ok) {
+		printf("can't write %s\n", world_file.c_str());
+		return 1;
+	}
+
+	world_file_t world(world_file);
+	printf("wrote %d chunks to %s, %zu bytes\n", world.count(),
+			world_file.c_str(), world.size);
+	return 0;
+}
@@ -1,13 +1,37 @@
 #ifndef GAME_MAP_H
 #define GAME_MAP_H
 
+#include <climits>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <unordered_map>
 #include "json.h"
 
 #define CHK_SZ 32
+#define CHK_SHIFT 5
+
+static_assert(CHK_SZ == 1 << CHK_SHIFT, "CHK_SHIFT must match CHK_SZ");
 
 struct GameMap {
+	/* m holds the cells as loaded, walk is the same chunk as a bitboard, bit j
+	of walk[i] is set if cell (i, j) is walkable ('.'). Keep them in sync with
+	GameMap::set() or update_walk() after writing m directly. */
 	struct chunk_t {
 		char m[CHK_SZ][CHK_SZ] = {0};
+		uint32_t walk[CHK_SZ] = {0};
+
+		void update_walk() {
+			for (int i = 0; i < CHK_SZ; i++) {
+				walk[i] = 0;
+				for (int j = 0; j < CHK_SZ; j++)
+					walk[i] |= uint32_t(m[i][j] == '.') << j;
+			}
+		}
+
+		bool walkable(int i, int j) const {
+			return (walk[i] >> j) & 1;
+		}
 
 		char *operator [] (int i) {
 			if (i < 0 || i >= CHK_SZ)
@@ -24,7 +48,7 @@ struct GameMap {
 
 	using key_t = Math::Point2i;
 	std::function<int(const key_t&)> key_hash = [](const key_t& k) {
-		return hash<int>()(k.x) ^ hash<int>()(k.y);
+		return std::hash<int>()(k.x) ^ std::hash<int>()(k.y);
 	};
 	using key_hash_t = decltype(key_hash);
 	using map_data_t = std::unordered_map<const key_t, chunk_t, key_hash_t,
@@ -32,6 +56,80 @@ struct GameMap {
 
 	map_data_t data;
 
+	/* Chunk directory, pointers to the chunks of data in pages of DIR_PAGE x
+	DIR_PAGE chunks. Only pages that hold chunks exist, a page is dropped with
+	it's last chunk, so the directory grows with the chunks that are in the map
+	and not with the area they ever covered. Finding a chunk is a page lookup
+	and an index, the last chunk and the last page are cached, most lookups hit
+	the chunk of the previous one. Chunks must be added and removed with
+	add_chunk() and remove_chunk() (set() and operator() add them too) to keep
+	the directory in sync. */
+	constexpr static int DIR_SHIFT = 4;
+	constexpr static int DIR_PAGE = 1 << DIR_SHIFT;
+
+	struct dir_page_t {
+		chunk_t *chunks[DIR_PAGE * DIR_PAGE] = {NULL};
+		int count = 0;
+	};
+
+	std::unordered_map<int64_t, dir_page_t> dir;
+	mutable int64_t last_page_key = INT64_MIN;
+	mutable dir_page_t *last_page = NULL;
+	mutable int last_row = INT_MIN;
+	mutable int last_col = INT_MIN;
+	mutable chunk_t *last = NULL;
+
+	/* Read only walk over the cells. Moving inside a chunk is index arithmetic,
+	the directory is only used when a move leaves the chunk. Cells of missing
+	chunks read as 0. */
+	struct cursor_t {
+		const GameMap *map;
+		const chunk_t *chunk;
+		int row;
+		int col;
+		int li;
+		int lj;
+
+		char operator * () const {
+			return chunk ? chunk->m[li][lj] : 0;
+		}
+
+		bool walkable() const {
+			return chunk && chunk->walkable(li, lj);
+		}
+
+		Math::Point2i pos() const {
+			return Math::Point2i(row * CHK_SZ + li, col * CHK_SZ + lj);
+		}
+
+		void move(int di, int dj) {
+			li += di;
+			lj += dj;
+			if (li < 0 || lj < 0 || li >= CHK_SZ || lj >= CHK_SZ) {
+				row += li >> CHK_SHIFT;
+				col += lj >> CHK_SHIFT;
+				li &= CHK_SZ - 1;
+				lj &= CHK_SZ - 1;
+				chunk = map->find_chunk(row, col);
+			}
+		}
+
+		cursor_t neigh(int di, int dj) const {
+			cursor_t ret = *this;
+			ret.move(di, dj);
+			return ret;
+		}
+	};
+
+	/* empty map, chunks are added with add_chunk() or set() */
+	GameMap()
+	: data(std::unordered_map<int, int>{}.bucket_count(), key_hash)
+	{}
+
+	/* the directory points inside data */
+	GameMap(const GameMap&) = delete;
+	GameMap &operator = (const GameMap&) = delete;
+
 	GameMap(std::string map_file)
 	: data(std::unordered_map<int, int>{}.bucket_count(), key_hash)
 	{
@@ -46,48 +144,103 @@ struct GameMap {
 			std::string chunk_file = chunk_desc["filename"];
 			printf("loading: chunk [%d, %d] at [%s]\n",
 					row, col, chunk_file.c_str());
-			data[{row, col}] = load_chunk(chunk_file);
+			add_chunk(row, col) = load_chunk(chunk_file);
 		}
 	}
 
-	char &operator () (int i, int j) {
-		int row = div(i, CHK_SZ);
-		int col = div(j, CHK_SZ);
-		return data[{row, col}][abs(i - row * CHK_SZ)][abs(j - col * CHK_SZ)];
-	}
-
-	void draw(Math::Point2f cam_pos) {
-		Math::Point2i pos = div(cam_pos + Math::Point2f(1, -1), SIDE);
-		pos.y *= -1;
-		Math::Point2i dirs[] = {
-			{-1,  1}, { 0,  1}, { 1,  1},
-			{-1,  0}, { 0,  0}, { 1,  0},
-			{-1, -1}, { 0, -1}, { 1, -1},
-		};
-
-		// drawLine();
-		draw_circle(pos.y, pos.x, SIDE, MAGENTA);
-		auto p = div(pos, CHK_SZ) * CHK_SZ;
-		draw_circle(p.y, p.x, SIDE, BLUE);
-
-		for (auto &&dir : dirs) {
-			auto p = div(pos, CHK_SZ) * CHK_SZ + dir * CHK_SZ;
-			draw_grid(p.x, -p.y, CHK_SZ, CHK_SZ);
-
-			for (int i = p.y; i < CHK_SZ + p.y; i++) {
-				for (int j = p.x; j < CHK_SZ + p.x; j++) {
-					if ((*this)(i, j) == '#')
-						draw_wall(i, j);
-					else if ((*this)(i, j) != '.')
-						draw_cross(i, j);
-				}
-			}
+	static int64_t page_key(int row, int col) {
+		return int64_t(uint64_t(uint32_t(row >> DIR_SHIFT)) << 32 |
+				uint32_t(col >> DIR_SHIFT));
+	}
+
+	static int page_index(int row, int col) {
+		return (row & (DIR_PAGE - 1)) * DIR_PAGE + (col & (DIR_PAGE - 1));
+	}
+
+	dir_page_t *find_page(int row, int col) {
+		int64_t key = page_key(row, col);
+		if (key != last_page_key) {
+			auto it = dir.find(key);
+			last_page_key = key;
+			last_page = it == dir.end() ? NULL : &it->second;
 		}
+		return last_page;
+	}
+
+	/* the chunk at (row, col) if it exists, never inserts */
+	chunk_t *find_chunk(int row, int col) {
+		if (row == last_row && col == last_col)
+			return last;
+		auto page = find_page(row, col);
+		last_row = row;
+		last_col = col;
+		last = page ? page->chunks[page_index(row, col)] : NULL;
+		return last;
+	}
+
+	const chunk_t *find_chunk(int row, int col) const {
+		return const_cast<GameMap *>(this)->find_chunk(row, col);
+	}
+
+	/* the chunk at (row, col), an empty one is inserted if it's missing */
+	chunk_t &add_chunk(int row, int col) {
+		if (auto chunk = find_chunk(row, col))
+			return *chunk;
+		auto &chunk = data[{row, col}];
+		auto &page = dir[page_key(row, col)];
+		page.chunks[page_index(row, col)] = &chunk;
+		page.count++;
+		last_row = INT_MIN;
+		last_page_key = INT64_MIN;
+		return chunk;
+	}
+
+	void remove_chunk(int row, int col) {
+		if (!find_chunk(row, col))
+			return ;
+		auto it = dir.find(page_key(row, col));
+		it->second.chunks[page_index(row, col)] = NULL;
+		if (!--it->second.count)
+			dir.erase(it);
+		data.erase({row, col});
+		last_row = INT_MIN;
+		last_page_key = INT64_MIN;
+	}
+
+	/* the cell at (i, j), 0 if it's chunk is missing */
+	char get(int i, int j) const {
+		auto chunk = find_chunk(i >> CHK_SHIFT, j >> CHK_SHIFT);
+		return chunk ? chunk->m[i & (CHK_SZ - 1)][j & (CHK_SZ - 1)] : 0;
+	}
+
+	bool walkable(int i, int j) const {
+		auto chunk = find_chunk(i >> CHK_SHIFT, j >> CHK_SHIFT);
+		return chunk && chunk->walkable(i & (CHK_SZ - 1), j & (CHK_SZ - 1));
+	}
+
+	cursor_t cursor(int i, int j) const {
+		int row = i >> CHK_SHIFT;
+		int col = j >> CHK_SHIFT;
+		return cursor_t{this, find_chunk(row, col), row, col,
+				i & (CHK_SZ - 1), j & (CHK_SZ - 1)};
+	}
+
+	/* inserts the chunk of the cell if it's missing, use get() to read */
+	char &operator () (int i, int j) {
+		auto &chunk = add_chunk(i >> CHK_SHIFT, j >> CHK_SHIFT);
+		return chunk.m[i & (CHK_SZ - 1)][j & (CHK_SZ - 1)];
 	}
 
-	Math::Point2i get_index(Math::Point2f cursor) {
-		Math::Point2i pos = div(cursor, SIDE);
-		return {-pos.y - 1, pos.x};
+	/* writes a cell and keeps the walk bits of it's chunk up to date */
+	void set(int i, int j, char c) {
+		auto &chunk = add_chunk(i >> CHK_SHIFT, j >> CHK_SHIFT);
+		int li = i & (CHK_SZ - 1);
+		int lj = j & (CHK_SZ - 1);
+		chunk.m[li][lj] = c;
+		if (c == '.')
+			chunk.walk[li] |= 1u << lj;
+		else
+			chunk.walk[li] &= ~(1u << lj);
 	}
 
 	int div(int a, float b) {
@@ -119,6 +272,7 @@ struct GameMap {
 			}
 			i++;
 		}
+		ret.update_walk();
 		return ret;
 	}	
 
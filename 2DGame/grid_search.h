@@ -0,0 +1,401 @@
+#ifndef GRID_SEARCH_H
+#define GRID_SEARCH_H
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include "game_map.h"
+#include "clearance_map.h"
+#include "connectivity.h"
+#include "chunk_manager.h"
+#include "landmarks.h"
+#include "priority_queues.h"
+
+/* Grid search engine for the chunked GameMap.
+
+The per node state (g cost, parent, closed flag) is kept in flat arrays, one
+block of CHK_SZ * CHK_SZ nodes for every chunk a search touched. Blocks live as
+long as the engine does and a node is considered fresh only if it's generation
+matches the current query, so starting a new search is just a counter bump.
+Blocks also remember their 8 neighbour blocks so crossing a chunk border
+doesn't need a hash lookup after the first time.
+
+Walkability is read from the walk bits of the chunks, inside a chunk the 8
+neighbours of a cell are tested at once with neigh_mask().
+
+Chunks that don't exist in the map are treated as walls and are never inserted
+in the map. If chunks are added to or removed from the map call reset(). With a
+chunk manager set in chunks, a search that reaches a chunk that is listed but
+not resident yet sets not_resident, the path it found may get better once that
+chunk is loaded.
+
+Searches are done for units of size x size cells, with the unit on the top
+left cell of it's square. Sizes over 1 need the clearance map, a cell is then
+walkable if it's clearance is at least the size.
+
+With landmark tables set in landmarks the heuristic is the largest of the
+octile distance and the ALT bound, the tables are only used while they are up
+to date with the map.
+
+With a connectivity index, targets that can't be reached from the start are
+moved to the closest reachable cell before searching, so the search doesn't
+flood the whole component of the start.
+
+The open list is a template parameter, any of the queues in priority_queues.h,
+grid_search_t is the engine with the binary heap. */
+
+struct null_visitor_t {
+	void expand(int i, int j) {}
+	void update(int i, int j) {}
+};
+
+template <typename queue_t = binary_heap_t>
+struct basic_grid_search_t {
+	constexpr static int CHK_AREA = CHK_SZ * CHK_SZ;
+	constexpr static int NONE = -1;
+	constexpr static int UNRESOLVED = -2;
+	constexpr static int INF = 2000'000'000;
+
+	struct node_t {
+		uint32_t gen = 0;
+		int g;
+		int parent;
+		bool closed;
+	};
+
+	struct block_t {
+		GameMap::key_t key;
+		const GameMap::chunk_t *chunk;
+		const clearance_map_t::chunk_t *clear;
+		const landmarks_t::chunk_t *alt;
+		bool pending;
+		int neigh[9];
+		std::vector<node_t> nodes;
+	};
+
+	constexpr static int dir_i[] = {-1,  0,  1, -1,  1, -1,  0,  1};
+	constexpr static int dir_j[] = { 1,  1,  1,  0,  0, -1, -1, -1};
+	constexpr static int dir_cost[] = {14, 10, 14, 10, 10, 14, 10, 14};
+	constexpr static int dir_index[] = {5, 3, 0, 6, NONE, 1, 7, 4, 2};
+
+	GameMap &map;
+	const clearance_map_t *clearance;
+	const connectivity_t *connectivity;
+	const chunk_manager_t *chunks = NULL;
+	const landmarks_t *landmarks = NULL;
+	const landmarks_t::chunk_t *target_alt = NULL;
+	int target_l = 0;
+	uint32_t alt_version = 0;
+	std::vector<block_t> blocks;
+	std::unordered_map<int64_t, int> block_idx;
+	queue_t open;
+	uint32_t gen = 0;
+
+	int start_id = NONE;
+	int target_id = NONE;
+	int best_id = NONE;
+	int ti = 0;
+	int tj = 0;
+	int expanded = 0;
+	size_t peak_open = 0;
+	int size = 1;
+	bool redirected = false;
+	bool not_resident = false;
+
+	basic_grid_search_t(GameMap &map,
+			const clearance_map_t *clearance = NULL,
+			const connectivity_t *connectivity = NULL)
+	: map(map), clearance(clearance), connectivity(connectivity) {}
+
+	void reset() {
+		blocks.clear();
+		block_idx.clear();
+		gen = 0;
+	}
+
+	static int64_t chunk_key(int row, int col) {
+		return (int64_t(row) << 32) | uint32_t(col);
+	}
+
+	int get_block(int row, int col) {
+		auto it = block_idx.find(chunk_key(row, col));
+		if (it != block_idx.end())
+			return it->second;
+
+		block_t block;
+		block.key = GameMap::key_t(row, col);
+		block.chunk = map.find_chunk(row, col);
+		block.clear = clearance ? clearance->get_chunk(row, col) : NULL;
+		block.alt = landmarks ? landmarks->get_chunk(row, col) : NULL;
+		block.pending = !block.chunk && chunks && chunks->pending(row, col);
+		for (auto &&n : block.neigh)
+			n = UNRESOLVED;
+		block.nodes.resize(CHK_AREA);
+
+		blocks.push_back(std::move(block));
+		block_idx[chunk_key(row, col)] = blocks.size() - 1;
+		return blocks.size() - 1;
+	}
+
+	int link(int b, int ci, int cj) {
+		int k = (ci + 1) * 3 + cj + 1;
+		if (blocks[b].neigh[k] == UNRESOLVED) {
+			int row = blocks[b].key.x + ci;
+			int col = blocks[b].key.y + cj;
+			int nb = get_block(row, col);
+			blocks[b].neigh[k] = nb;
+		}
+		int nb = blocks[b].neigh[k];
+		if (blocks[nb].pending)
+			not_resident = true;
+		return nb;
+	}
+
+	int id_of(int i, int j) {
+		int row = floor_div(i);
+		int col = floor_div(j);
+		return get_block(row, col) * CHK_AREA +
+				(i - row * CHK_SZ) * CHK_SZ + (j - col * CHK_SZ);
+	}
+
+	Math::Point2i pos_of(int id) const {
+		auto &key = blocks[id / CHK_AREA].key;
+		int l = id % CHK_AREA;
+		return Math::Point2i(key.x * CHK_SZ + l / CHK_SZ,
+				key.y * CHK_SZ + l % CHK_SZ);
+	}
+
+	int neigh_id(int id, int di, int dj) {
+		int b = id / CHK_AREA;
+		int l = id % CHK_AREA;
+		int li = l / CHK_SZ + di;
+		int lj = l % CHK_SZ + dj;
+		int ci = li < 0 ? -1 : (li >= CHK_SZ ? 1 : 0);
+		int cj = lj < 0 ? -1 : (lj >= CHK_SZ ? 1 : 0);
+		if (ci || cj)
+			b = link(b, ci, cj);
+		return b * CHK_AREA + (li - ci * CHK_SZ) * CHK_SZ + (lj - cj * CHK_SZ);
+	}
+
+	bool walkable(int id) const {
+		auto &block = blocks[id / CHK_AREA];
+		int l = id % CHK_AREA;
+		if (size > 1)
+			return block.clear && block.clear->c[l / CHK_SZ][l % CHK_SZ] >= size;
+		return block.chunk && block.chunk->walkable(l / CHK_SZ, l % CHK_SZ);
+	}
+
+	/* k of the direction (di, dj), di and dj in [-1, 1] */
+	static int dir_of(int di, int dj) {
+		return dir_index[(di + 1) * 3 + dj + 1];
+	}
+
+	/* Bit k is set if the neighbour in direction k is walkable. Cells inside
+	the chunk read the three rows around them from the walk bits, cells on the
+	border and bigger units go one neighbour at a time. */
+	int neigh_mask(int id) {
+		auto &block = blocks[id / CHK_AREA];
+		int l = id % CHK_AREA;
+		int li = l / CHK_SZ;
+		int lj = l % CHK_SZ;
+		if (size == 1 && block.chunk && li > 0 && lj > 0 &&
+				li < CHK_SZ - 1 && lj < CHK_SZ - 1)
+		{
+			auto walk = block.chunk->walk;
+			int up = (walk[li - 1] >> (lj - 1)) & 7;
+			int mid = (walk[li] >> (lj - 1)) & 7;
+			int down = (walk[li + 1] >> (lj - 1)) & 7;
+			return (up >> 2) | (mid >> 2) << 1 | (down >> 2) << 2 |
+					((up >> 1) & 1) << 3 | ((down >> 1) & 1) << 4 |
+					(up & 1) << 5 | (mid & 1) << 6 | (down & 1) << 7;
+		}
+		int mask = 0;
+		for (int k = 0; k < 8; k++)
+			if (walkable(neigh_id(id, dir_i[k], dir_j[k])))
+				mask |= 1 << k;
+		return mask;
+	}
+
+	node_t &node(int id) {
+		return blocks[id / CHK_AREA].nodes[id % CHK_AREA];
+	}
+
+	node_t &touch(int id) {
+		node_t &n = node(id);
+		if (n.gen != gen) {
+			n.gen = gen;
+			n.g = INF;
+			n.parent = NONE;
+			n.closed = false;
+		}
+		return n;
+	}
+
+	bool seen(int id) {
+		return node(id).gen == gen;
+	}
+
+	int hcost(int i, int j) const {
+		int di = abs(ti - i);
+		int dj = abs(tj - j);
+		if (di > dj)
+			return (di - dj) * 10 + dj * 14;
+		else
+			return (dj - di) * 10 + di * 14;
+	}
+
+	/* octile distance, raised to the ALT bound when the node and the target
+	have landmark tables */
+	int hcost(int id, int i, int j) const {
+		int h = hcost(i, j);
+		if (target_alt) {
+			if (auto alt = blocks[id / CHK_AREA].alt)
+				h = std::max(h, landmarks->bound(*alt, id % CHK_AREA,
+						*target_alt, target_l));
+		}
+		return h;
+	}
+
+	/* takes the tables of the target, blocks get the new tables after each
+	rebuild of the landmarks */
+	void load_landmarks() {
+		target_alt = NULL;
+		if (!landmarks || landmarks->stale)
+			return ;
+		if (alt_version != landmarks->version) {
+			alt_version = landmarks->version;
+			for (auto &&block : blocks)
+				block.alt = landmarks->get_chunk(block.key.x, block.key.y);
+		}
+		target_alt = blocks[target_id / CHK_AREA].alt;
+		target_l = target_id % CHK_AREA;
+	}
+
+	/* the labels are for single cells, bigger units search as they are */
+	void redirect(int si, int sj, int &ti, int &tj) {
+		redirected = false;
+		if (chunks && chunks->pending(floor_div(ti), floor_div(tj)))
+			return ;
+		if (!connectivity || size > 1 ||
+				connectivity->reachable(si, sj, ti, tj))
+			return ;
+		int ri, rj;
+		if (connectivity->nearest_reachable(si, sj, ti, tj, ri, rj)) {
+			redirected = true;
+			ti = ri;
+			tj = rj;
+		}
+	}
+
+	void next_gen() {
+		not_resident = false;
+		if (++gen == 0) {
+			for (auto &&block : blocks)
+				for (auto &&n : block.nodes)
+					n.gen = 0;
+			gen = 1;
+		}
+	}
+
+	void push(int f, int h, int id) {
+		open.push(f, h, id);
+		peak_open = std::max(peak_open, open.size());
+	}
+
+	int pop() {
+		return open.pop();
+	}
+
+	/* A* from (si, sj) to (ti, tj), or Dijkstra if use_h is false. Returns true
+	if the target was reached, else the search ends on the discovered node that
+	is closest to the target. */
+	template <typename visitor_t>
+	bool search(int si, int sj, int ti, int tj, bool use_h, visitor_t &vis) {
+		redirect(si, sj, ti, tj);
+		next_gen();
+		open.clear();
+		expanded = 0;
+		peak_open = 0;
+		this->ti = ti;
+		this->tj = tj;
+
+		start_id = id_of(si, sj);
+		target_id = id_of(ti, tj);
+		best_id = start_id;
+		if (blocks[target_id / CHK_AREA].pending)
+			not_resident = true;
+		load_landmarks();
+
+		int best_h = hcost(start_id, si, sj);
+		auto &start = touch(start_id);
+		start.g = 0;
+		push(use_h ? best_h : 0, use_h ? best_h : 0, start_id);
+
+		while (!open.empty()) {
+			int top = pop();
+			if (node(top).closed)
+				continue;
+			if (top == target_id) {
+				best_id = target_id;
+				return true;
+			}
+			node(top).closed = true;
+			expanded++;
+
+			int g = node(top).g;
+			auto pos = pos_of(top);
+			vis.expand(pos.x, pos.y);
+
+			int mask = neigh_mask(top);
+			for (int k = 0; k < 8; k++) {
+				if (!((mask >> k) & 1))
+					continue ;
+				int nid = neigh_id(top, dir_i[k], dir_j[k]);
+
+				auto &neigh = touch(nid);
+				if (neigh.closed || neigh.g <= g + dir_cost[k])
+					continue ;
+
+				int ni = pos.x + dir_i[k];
+				int nj = pos.y + dir_j[k];
+				int h = hcost(nid, ni, nj);
+				if (best_h > h) {
+					best_h = h;
+					best_id = nid;
+				}
+				neigh.g = g + dir_cost[k];
+				neigh.parent = top;
+				push(neigh.g + (use_h ? h : 0), use_h ? h : 0, nid);
+				vis.update(ni, nj);
+			}
+		}
+		return false;
+	}
+
+	bool search(int si, int sj, int ti, int tj, bool use_h = true) {
+		null_visitor_t vis;
+		return search(si, sj, ti, tj, use_h, vis);
+	}
+
+	int cost() {
+		return best_id == NONE ? INF : node(best_id).g;
+	}
+
+	/* Path from the last search, start excluded, in walking order */
+	void get_path(std::vector<Math::Point2i> &path) {
+		size_t first = path.size();
+		for (int id = best_id; id != start_id && id != NONE;
+				id = node(id).parent)
+			path.push_back(pos_of(id));
+		std::reverse(path.begin() + first, path.end());
+	}
+
+	static int floor_div(int a) {
+		return a >= 0 ? a / CHK_SZ : -((-a + CHK_SZ - 1) / CHK_SZ);
+	}
+};
+
+using grid_search_t = basic_grid_search_t<>;
+
+#endif
@@ -0,0 +1,481 @@
+#ifndef HPA_SEARCH_H
+#define HPA_SEARCH_H
+
+#include <map>
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include "game_map.h"
+
+/* Hierarchical pathfinding (HPA*) with the map chunks as clusters.
+
+Every border between two neighbouring chunks (including the diagonal corner
+ones) is split in entrances, maximal runs of cells that can be crossed. Each
+entrance gives a transition: a node on each side and an edge between them. The
+nodes of a chunk are linked between them with the distances of the shortest
+paths that stay inside the chunk, these are computed once and cached in the
+node edges.
+
+A query links the start and the goal with the nodes of their chunks, runs A*
+on the abstract graph and returns a list of waypoints (start, transitions,
+goal). The waypoints are refined in cells one chunk at a time with refine().
+
+When the cells of a chunk change call update_chunk(), only the borders of that
+chunk and the cached distances of it and it's neighbours are recomputed. */
+
+struct hpa_search_t {
+	constexpr static int CHK_AREA = CHK_SZ * CHK_SZ;
+	constexpr static int INF = 2000'000'000;
+	constexpr static int NONE = -1;
+	constexpr static int LONG_ENTRANCE = 8;
+
+	struct node_t {
+		Math::Point2i pos;
+		int64_t cluster;
+		int local;
+		int refs = 0;
+		std::vector<std::pair<int, int>> edges;
+	};
+
+	struct transition_t {
+		int a;
+		int b;
+	};
+
+	struct path_t {
+		std::vector<Math::Point2i> waypoints;
+		size_t next = 1;
+		int cost = INF;
+		bool found = false;
+
+		bool done() const {
+			return next >= waypoints.size();
+		}
+	};
+
+	GameMap &map;
+	std::vector<node_t> nodes;
+	std::vector<int> free_nodes;
+	std::unordered_map<int64_t, std::vector<int>> clusters;
+	std::map<std::pair<int64_t, int64_t>, std::vector<transition_t>> borders;
+
+	/* local search buffers */
+	std::vector<int> ldist;
+	std::vector<int> lparent;
+	std::vector<std::pair<int, int>> lheap;
+
+	/* abstract search buffers */
+	std::vector<int> adist;
+	std::vector<int> aparent;
+	std::vector<bool> aclosed;
+	std::vector<std::pair<int, int>> aheap;
+	std::vector<std::pair<int, int>> start_edges;
+	std::vector<std::pair<int, int>> goal_edges;
+	std::vector<int> to_goal;
+	int expanded = 0;
+	size_t peak_open = 0;
+
+	hpa_search_t(GameMap &map)
+	: map(map), ldist(CHK_AREA), lparent(CHK_AREA) {
+		build();
+	}
+
+	static int64_t chunk_key(int row, int col) {
+		return (int64_t(row) << 32) | uint32_t(col);
+	}
+
+	static int key_row(int64_t key) {
+		return int32_t(key >> 32);
+	}
+
+	static int key_col(int64_t key) {
+		return int32_t(key & 0xffffffff);
+	}
+
+	static std::pair<int64_t, int64_t> border_key(int64_t a, int64_t b) {
+		return {std::min(a, b), std::max(a, b)};
+	}
+
+	static int floor_div(int a) {
+		return a >= 0 ? a / CHK_SZ : -((-a + CHK_SZ - 1) / CHK_SZ);
+	}
+
+	static int octile(int di, int dj) {
+		di = abs(di);
+		dj = abs(dj);
+		return di > dj ? (di - dj) * 10 + dj * 14 : (dj - di) * 10 + di * 14;
+	}
+
+	const GameMap::chunk_t *get_chunk(int64_t key) const {
+		return map.find_chunk(key_row(key), key_col(key));
+	}
+
+	static bool walkable(const GameMap::chunk_t *chunk, int i, int j) {
+		return chunk && chunk->walkable(i, j);
+	}
+
+	void build() {
+		nodes.clear();
+		free_nodes.clear();
+		clusters.clear();
+		borders.clear();
+		for (auto &&[key, chunk] : map.data) {
+			int64_t a = chunk_key(key.x, key.y);
+			int dirs[4][2] = {{0, 1}, {1, 0}, {1, 1}, {1, -1}};
+			for (auto &&d : dirs) {
+				int64_t b = chunk_key(key.x + d[0], key.y + d[1]);
+				if (get_chunk(b))
+					add_border(a, b);
+			}
+		}
+		for (auto &&[key, chunk] : map.data)
+			build_intra(chunk_key(key.x, key.y));
+	}
+
+	void update_chunk(int row, int col) {
+		int64_t a = chunk_key(row, col);
+		for (int di = -1; di <= 1; di++)
+			for (int dj = -1; dj <= 1; dj++) {
+				if (!di && !dj)
+					continue ;
+				int64_t b = chunk_key(row + di, col + dj);
+				remove_border(a, b);
+				if (get_chunk(a) && get_chunk(b))
+					add_border(a, b);
+			}
+		for (int di = -1; di <= 1; di++)
+			for (int dj = -1; dj <= 1; dj++)
+				build_intra(chunk_key(row + di, col + dj));
+	}
+
+	int get_node(int64_t cluster, int li, int lj) {
+		int local = li * CHK_SZ + lj;
+		auto &list = clusters[cluster];
+		for (auto &&id : list)
+			if (nodes[id].local == local)
+				return id;
+
+		int id;
+		if (free_nodes.size()) {
+			id = free_nodes.back();
+			free_nodes.pop_back();
+		}
+		else {
+			id = nodes.size();
+			nodes.emplace_back();
+		}
+		auto &n = nodes[id];
+		n.pos = Math::Point2i(key_row(cluster) * CHK_SZ + li,
+				key_col(cluster) * CHK_SZ + lj);
+		n.cluster = cluster;
+		n.local = local;
+		n.refs = 0;
+		n.edges.clear();
+		list.push_back(id);
+		return id;
+	}
+
+	void release_node(int id) {
+		if (--nodes[id].refs > 0)
+			return ;
+		auto &list = clusters[nodes[id].cluster];
+		list.erase(std::find(list.begin(), list.end(), id));
+		for (auto &&e : nodes[id].edges) {
+			auto &oth = nodes[e.first].edges;
+			oth.erase(std::remove_if(oth.begin(), oth.end(),
+					[&](auto &x){ return x.first == id; }), oth.end());
+		}
+		nodes[id].edges.clear();
+		free_nodes.push_back(id);
+	}
+
+	void add_transition(std::vector<transition_t> &list, int64_t ca,
+			int ai, int aj, int64_t cb, int bi, int bj)
+	{
+		int a = get_node(ca, ai, aj);
+		int b = get_node(cb, bi, bj);
+		int cost = octile(nodes[a].pos.x - nodes[b].pos.x,
+				nodes[a].pos.y - nodes[b].pos.y);
+		nodes[a].refs++;
+		nodes[b].refs++;
+		nodes[a].edges.push_back({b, cost});
+		nodes[b].edges.push_back({a, cost});
+		list.push_back({a, b});
+	}
+
+	void remove_border(int64_t a, int64_t b) {
+		auto it = borders.find(border_key(a, b));
+		if (it == borders.end())
+			return ;
+		for (auto &&t : it->second) {
+			auto &ea = nodes[t.a].edges;
+			ea.erase(std::remove_if(ea.begin(), ea.end(),
+					[&](auto &x){ return x.first == t.b; }), ea.end());
+			auto &eb = nodes[t.b].edges;
+			eb.erase(std::remove_if(eb.begin(), eb.end(),
+					[&](auto &x){ return x.first == t.a; }), eb.end());
+			release_node(t.a);
+			release_node(t.b);
+		}
+		borders.erase(it);
+	}
+
+	void add_border(int64_t a, int64_t b) {
+		if (std::pair(key_row(a), key_col(a)) >
+				std::pair(key_row(b), key_col(b)))
+			std::swap(a, b);
+		auto &list = borders[border_key(a, b)];
+		auto ca = get_chunk(a);
+		auto cb = get_chunk(b);
+		int dr = key_row(b) - key_row(a);
+		int dc = key_col(b) - key_col(a);
+		const int L = CHK_SZ - 1;
+
+		/* corners */
+		if (dr && dc) {
+			int aj = dc > 0 ? L : 0;
+			int bj = dc > 0 ? 0 : L;
+			if (walkable(ca, L, aj) && walkable(cb, 0, bj))
+				add_transition(list, a, L, aj, b, 0, bj);
+			return ;
+		}
+
+		/* edges, t walks along the border, A is always above or left of B */
+		auto cell_a = [&](int t) {
+			return dr ? walkable(ca, L, t) : walkable(ca, t, L);
+		};
+		auto cell_b = [&](int t) {
+			return t >= 0 && t < CHK_SZ &&
+					(dr ? walkable(cb, 0, t) : walkable(cb, t, 0));
+		};
+		auto add = [&](int ta, int tb) {
+			if (dr)
+				add_transition(list, a, L, ta, b, 0, tb);
+			else
+				add_transition(list, a, ta, L, b, tb, 0);
+		};
+		auto straight = [&](int t) {
+			return t >= 0 && t < CHK_SZ && cell_a(t) && cell_b(t);
+		};
+
+		for (int t = 0; t < CHK_SZ; ) {
+			if (!straight(t)) {
+				/* diagonal only crossings, when no straight entrance
+				covers them */
+				for (int d = -1; d <= 1; d += 2)
+					if (cell_a(t) && cell_b(t + d) && !straight(t + d))
+						add(t, t + d);
+				t++;
+				continue ;
+			}
+			int end = t;
+			while (straight(end + 1))
+				end++;
+			if (end - t + 1 >= LONG_ENTRANCE) {
+				add(t, t);
+				add(end, end);
+			}
+			else {
+				add((t + end) / 2, (t + end) / 2);
+			}
+			t = end + 1;
+		}
+	}
+
+	/* Dijkstra inside a chunk, from local cell src, stops early when dst is
+	reached. Distances are left in ldist and parents in lparent */
+	void local_search(const GameMap::chunk_t *chunk, int src, int dst = NONE) {
+		std::fill(ldist.begin(), ldist.end(), INF);
+		std::fill(lparent.begin(), lparent.end(), NONE);
+		lheap.clear();
+		ldist[src] = 0;
+		lheap.push_back({0, src});
+		while (lheap.size()) {
+			std::pop_heap(lheap.begin(), lheap.end(), std::greater<>());
+			auto [d, cell] = lheap.back();
+			lheap.pop_back();
+			if (d > ldist[cell])
+				continue ;
+			if (cell == dst)
+				return ;
+			int ci = cell / CHK_SZ;
+			int cj = cell % CHK_SZ;
+			for (int di = -1; di <= 1; di++)
+				for (int dj = -1; dj <= 1; dj++) {
+					int ni = ci + di;
+					int nj = cj + dj;
+					if ((!di && !dj) || ni < 0 || nj < 0 ||
+							ni >= CHK_SZ || nj >= CHK_SZ ||
+							!walkable(chunk, ni, nj))
+						continue ;
+					int nd = d + (di && dj ? 14 : 10);
+					int ncell = ni * CHK_SZ + nj;
+					if (nd < ldist[ncell]) {
+						ldist[ncell] = nd;
+						lparent[ncell] = cell;
+						lheap.push_back({nd, ncell});
+						std::push_heap(lheap.begin(), lheap.end(),
+								std::greater<>());
+					}
+				}
+		}
+	}
+
+	void build_intra(int64_t cluster) {
+		auto it = clusters.find(cluster);
+		if (it == clusters.end())
+			return ;
+		auto &list = it->second;
+		for (auto &&id : list) {
+			auto &edges = nodes[id].edges;
+			edges.erase(std::remove_if(edges.begin(), edges.end(),
+					[&](auto &x){ return nodes[x.first].cluster == cluster; }),
+					edges.end());
+		}
+		auto chunk = get_chunk(cluster);
+		for (auto &&id : list) {
+			local_search(chunk, nodes[id].local);
+			for (auto &&oth : list)
+				if (oth != id && ldist[nodes[oth].local] != INF)
+					nodes[id].edges.push_back({oth, ldist[nodes[oth].local]});
+		}
+	}
+
+	/* links the query point with the nodes of it's chunk */
+	void link_point(int i, int j, std::vector<std::pair<int, int>> &out) {
+		out.clear();
+		int row = floor_div(i);
+		int col = floor_div(j);
+		int64_t key = chunk_key(row, col);
+		auto chunk = get_chunk(key);
+		auto it = clusters.find(key);
+		if (!chunk || it == clusters.end())
+			return ;
+		local_search(chunk, (i - row * CHK_SZ) * CHK_SZ + j - col * CHK_SZ);
+		for (auto &&id : it->second)
+			if (ldist[nodes[id].local] != INF)
+				out.push_back({id, ldist[nodes[id].local]});
+	}
+
+	/* Abstract A* from (si, sj) to (ti, tj), fills path with the waypoints */
+	bool find(int si, int sj, int ti, int tj, path_t &path) {
+		path = path_t();
+		expanded = 0;
+		peak_open = 0;
+		int n = nodes.size();
+		int S = n;
+		int G = n + 1;
+		adist.assign(n + 2, INF);
+		aparent.assign(n + 2, NONE);
+		aclosed.assign(n + 2, false);
+		aheap.clear();
+
+		auto pos = [&](int id) {
+			if (id == S)
+				return Math::Point2i(si, sj);
+			if (id == G)
+				return Math::Point2i(ti, tj);
+			return nodes[id].pos;
+		};
+		auto h = [&](int id) {
+			auto p = pos(id);
+			return octile(p.x - ti, p.y - tj);
+		};
+
+		int srow = floor_div(si), scol = floor_div(sj);
+		int trow = floor_div(ti), tcol = floor_div(tj);
+		int64_t tkey = chunk_key(trow, tcol);
+		if (!walkable(get_chunk(tkey), ti - trow * CHK_SZ, tj - tcol * CHK_SZ))
+			return false;
+		int direct = INF;
+		if (srow == trow && scol == tcol && get_chunk(tkey)) {
+			int dst = (ti - trow * CHK_SZ) * CHK_SZ + tj - tcol * CHK_SZ;
+			local_search(get_chunk(tkey),
+					(si - srow * CHK_SZ) * CHK_SZ + sj - scol * CHK_SZ, dst);
+			direct = ldist[dst];
+		}
+		link_point(ti, tj, goal_edges);
+		to_goal.assign(n, INF);
+		for (auto &&e : goal_edges)
+			to_goal[e.first] = e.second;
+		link_point(si, sj, start_edges);
+
+		auto relax = [&](int from, int to, int cost) {
+			int nd = adist[from] + cost;
+			if (!aclosed[to] && nd < adist[to]) {
+				adist[to] = nd;
+				aparent[to] = from;
+				aheap.push_back({nd + h(to), to});
+				std::push_heap(aheap.begin(), aheap.end(), std::greater<>());
+				peak_open = std::max(peak_open, aheap.size());
+			}
+		};
+
+		adist[S] = 0;
+		aheap.push_back({h(S), S});
+		while (aheap.size()) {
+			std::pop_heap(aheap.begin(), aheap.end(), std::greater<>());
+			int id = aheap.back().second;
+			aheap.pop_back();
+			if (aclosed[id])
+				continue ;
+			aclosed[id] = true;
+			if (id == G)
+				break ;
+			expanded++;
+
+			if (id == S) {
+				if (direct != INF)
+					relax(S, G, direct);
+				for (auto &&e : start_edges)
+					relax(S, e.first, e.second);
+				continue ;
+			}
+			if (to_goal[id] != INF)
+				relax(id, G, to_goal[id]);
+			for (auto &&e : nodes[id].edges)
+				relax(id, e.first, e.second);
+		}
+
+		if (adist[G] == INF)
+			return false;
+		for (int id = G; id != NONE; id = aparent[id])
+			path.waypoints.push_back(pos(id));
+		std::reverse(path.waypoints.begin(), path.waypoints.end());
+		path.cost = adist[G];
+		path.found = true;
+		return true;
+	}
+
+	/* Appends the cells from the next waypoint segment of path to cells.
+	Consecutive waypoints are either in the same chunk or are the two sides
+	of a transition, so each call does at most one local search. Returns
+	false once the whole path has been refined. */
+	bool refine(path_t &path, std::vector<Math::Point2i> &cells) {
+		if (path.done())
+			return false;
+		auto a = path.waypoints[path.next - 1];
+		auto b = path.waypoints[path.next];
+		path.next++;
+
+		int arow = floor_div(a.x), acol = floor_div(a.y);
+		int brow = floor_div(b.x), bcol = floor_div(b.y);
+		if (arow != brow || acol != bcol) {
+			cells.push_back(b);
+			return true;
+		}
+		Math::Point2i base(arow * CHK_SZ, acol * CHK_SZ);
+		int src = (a.x - base.x) * CHK_SZ + a.y - base.y;
+		int dst = (b.x - base.x) * CHK_SZ + b.y - base.y;
+		local_search(get_chunk(chunk_key(arow, acol)), src, dst);
+
+		size_t first = cells.size();
+		for (int cell = dst; cell != src && cell != NONE; cell = lparent[cell])
+			cells.push_back(base + Math::Point2i(cell / CHK_SZ,
+					cell % CHK_SZ));
+		std::reverse(cells.begin() + first, cells.end());
+		return true;
+	}
+};
+
+#endif
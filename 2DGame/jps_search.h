@@ -0,0 +1,232 @@
+#ifndef JPS_SEARCH_H
+#define JPS_SEARCH_H
+
+#include "grid_search.h"
+
+/* Jump Point Search on top of the grid_search_t node store.
+
+Uses the same movement rules as the A* in grid_search_t: 8 neighbours, cost 10
+for straight and 14 for diagonal moves and diagonals may cut corners, so the
+pruning rules are the ones from the original JPS paper. Only jump points are
+pushed in the open list, the cells in between are filled back in by
+get_path(), so the resulting path has the same cost as the A* one. */
+
+template <typename queue_t = binary_heap_t>
+struct basic_jps_search_t : public basic_grid_search_t<queue_t> {
+	using base_t = basic_grid_search_t<queue_t>;
+	using base_t::base_t;
+	using base_t::NONE;
+	using base_t::dir_i;
+	using base_t::dir_j;
+	using base_t::open;
+	using base_t::expanded;
+	using base_t::peak_open;
+	using base_t::start_id;
+	using base_t::target_id;
+	using base_t::best_id;
+	using base_t::walkable;
+	using base_t::neigh_mask;
+	using base_t::dir_of;
+	using base_t::neigh_id;
+	using base_t::id_of;
+	using base_t::pos_of;
+	using base_t::node;
+	using base_t::touch;
+	using base_t::hcost;
+	using base_t::push;
+	using base_t::pop;
+	using base_t::next_gen;
+	using base_t::redirect;
+	using base_t::blocks;
+	using base_t::not_resident;
+	using base_t::CHK_AREA;
+
+	/* mask is the neigh_mask() of the cell */
+	static bool blocked(int mask, int di, int dj) {
+		return !((mask >> dir_of(di, dj)) & 1);
+	}
+
+	int jump(int id, int di, int dj) {
+		while (true) {
+			id = neigh_id(id, di, dj);
+			if (!walkable(id))
+				return NONE;
+			if (id == target_id)
+				return id;
+			int mask = neigh_mask(id);
+
+			if (di && dj) {
+				if (blocked(mask, -di, 0) && !blocked(mask, -di, dj))
+					return id;
+				if (blocked(mask, 0, -dj) && !blocked(mask, di, -dj))
+					return id;
+				if (jump(id, di, 0) != NONE || jump(id, 0, dj) != NONE)
+					return id;
+			}
+			else if (di) {
+				if (blocked(mask, 0, 1) && !blocked(mask, di, 1))
+					return id;
+				if (blocked(mask, 0, -1) && !blocked(mask, di, -1))
+					return id;
+			}
+			else {
+				if (blocked(mask, 1, 0) && !blocked(mask, 1, dj))
+					return id;
+				if (blocked(mask, -1, 0) && !blocked(mask, -1, dj))
+					return id;
+			}
+		}
+	}
+
+	/* writes the directions to jump in from id into dirs, returns the count */
+	int successors(int id, int di, int dj, int (*dirs)[2]) {
+		int mask = neigh_mask(id);
+		int cnt = 0;
+		auto add = [&](int a, int b) {
+			dirs[cnt][0] = a;
+			dirs[cnt][1] = b;
+			cnt++;
+		};
+
+		if (!di && !dj) {
+			for (int k = 0; k < 8; k++)
+				add(dir_i[k], dir_j[k]);
+		}
+		else if (di && dj) {
+			add(di, 0);
+			add(0, dj);
+			add(di, dj);
+			if (blocked(mask, -di, 0))
+				add(-di, dj);
+			if (blocked(mask, 0, -dj))
+				add(di, -dj);
+		}
+		else if (di) {
+			add(di, 0);
+			if (blocked(mask, 0, 1))
+				add(di, 1);
+			if (blocked(mask, 0, -1))
+				add(di, -1);
+		}
+		else {
+			add(0, dj);
+			if (blocked(mask, 1, 0))
+				add(1, dj);
+			if (blocked(mask, -1, 0))
+				add(-1, dj);
+		}
+		return cnt;
+	}
+
+	static int sign(int a) {
+		return (a > 0) - (a < 0);
+	}
+
+	static int octile(int di, int dj) {
+		di = abs(di);
+		dj = abs(dj);
+		return di > dj ? (di - dj) * 10 + dj * 14 : (dj - di) * 10 + di * 14;
+	}
+
+	template <typename visitor_t>
+	bool search(int si, int sj, int ti, int tj, visitor_t &vis) {
+		redirect(si, sj, ti, tj);
+		next_gen();
+		open.clear();
+		expanded = 0;
+		peak_open = 0;
+		this->ti = ti;
+		this->tj = tj;
+
+		start_id = id_of(si, sj);
+		target_id = id_of(ti, tj);
+		best_id = start_id;
+		if (blocks[target_id / CHK_AREA].pending)
+			not_resident = true;
+		this->load_landmarks();
+
+		int best_h = hcost(start_id, si, sj);
+		auto &start = touch(start_id);
+		start.g = 0;
+		push(best_h, best_h, start_id);
+
+		int dirs[8][2];
+		while (!open.empty()) {
+			int top = pop();
+			if (node(top).closed)
+				continue;
+			if (top == target_id) {
+				best_id = target_id;
+				return true;
+			}
+			node(top).closed = true;
+			expanded++;
+
+			int g = node(top).g;
+			int parent = node(top).parent;
+			auto pos = pos_of(top);
+			vis.expand(pos.x, pos.y);
+
+			int di = 0;
+			int dj = 0;
+			if (parent != NONE) {
+				auto ppos = pos_of(parent);
+				di = sign(pos.x - ppos.x);
+				dj = sign(pos.y - ppos.y);
+			}
+
+			int cnt = successors(top, di, dj, dirs);
+			for (int k = 0; k < cnt; k++) {
+				int jid = jump(top, dirs[k][0], dirs[k][1]);
+				if (jid == NONE)
+					continue ;
+
+				auto jpos = pos_of(jid);
+				int cost = g + octile(jpos.x - pos.x, jpos.y - pos.y);
+				auto &jp = touch(jid);
+				if (jp.closed || jp.g <= cost)
+					continue ;
+
+				int h = hcost(jid, jpos.x, jpos.y);
+				if (best_h > h) {
+					best_h = h;
+					best_id = jid;
+				}
+				jp.g = cost;
+				jp.parent = top;
+				push(cost + h, h, jid);
+				vis.update(jpos.x, jpos.y);
+			}
+		}
+		return false;
+	}
+
+	bool search(int si, int sj, int ti, int tj) {
+		null_visitor_t vis;
+		return search(si, sj, ti, tj, vis);
+	}
+
+	/* Same as grid_search_t::get_path, the cells between jump points are
+	walked back in so units still get one waypoint per tile */
+	void get_path(std::vector<Math::Point2i> &path) {
+		size_t first = path.size();
+		for (int id = best_id; id != start_id && id != NONE;
+				id = node(id).parent)
+		{
+			auto pos = pos_of(id);
+			auto ppos = node(id).parent == NONE ? pos :
+					pos_of(node(id).parent);
+			int di = sign(ppos.x - pos.x);
+			int dj = sign(ppos.y - pos.y);
+			while (!(pos == ppos)) {
+				path.push_back(pos);
+				pos = pos + Math::Point2i(di, dj);
+			}
+		}
+		std::reverse(path.begin() + first, path.end());
+	}
+};
+
+using jps_search_t = basic_jps_search_t<>;
+
+#endif
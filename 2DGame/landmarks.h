@@ -0,0 +1,290 @@
+#ifndef LANDMARKS_H
+#define LANDMARKS_H
+
+#include <vector>
+#include <array>
+#include <memory>
+#include <queue>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdint>
+#include "game_map.h"
+
+/* Landmark distance tables for the ALT heuristic (A*, Landmarks, Triangle
+inequality).
+
+A few landmark cells are picked far apart from each other (each new one is the
+cell farthest from the ones before it) and the exact path cost from every
+landmark to every cell is stored. For any landmark L the triangle inequality
+gives |d(L, t) - d(L, n)| <= d(n, t), the largest of those over the landmarks
+is a heuristic that never overestimates and is much closer to the real cost
+than the octile distance when walls are in the way.
+
+Costs are stored per chunk as uint16_t, landmark after landmark, FAR is a cost
+that didn't fit or a cell the landmark can't reach. A FAR cost is still a lower
+bound of 65535, so only pairs where both costs are FAR give nothing.
+
+Tables are computed from a copy of the walk bits of the map. update_chunk()
+drops the tables at once, they would overestimate if walls were removed, and
+poll() hands a new copy to the background thread and takes the new tables when
+they are ready, version counts the swaps. Without the thread (background false)
+poll() rebuilds in place. Chunks missing from the map are walls. */
+
+struct landmarks_t {
+	constexpr static int DEFAULT_COUNT = 8;
+	constexpr static int CHK_AREA = CHK_SZ * CHK_SZ;
+	constexpr static uint16_t FAR = 0xffff;
+	constexpr static int INF = 2000'000'000;
+
+	struct chunk_t {
+		std::vector<uint16_t> d;
+	};
+
+	struct tables_t {
+		std::vector<Math::Point2i> points;
+		std::unordered_map<int64_t, chunk_t> chunks;
+	};
+
+	struct snapshot_t {
+		std::vector<GameMap::key_t> keys;
+		std::vector<std::array<uint32_t, CHK_SZ>> walk;
+	};
+
+	GameMap &map;
+	int count;
+	std::unique_ptr<tables_t> tables;
+	uint32_t version = 0;
+	bool stale = true;
+	bool building = false;
+	uint64_t changes = 0;
+	uint64_t built_changes = 0;
+
+	bool background;
+	std::mutex mu;
+	std::condition_variable cv;
+	std::unique_ptr<snapshot_t> request;
+	std::unique_ptr<tables_t> done;
+	bool stop = false;
+	std::thread worker;
+
+	landmarks_t(GameMap &map, int count = DEFAULT_COUNT,
+			bool background = true)
+	: map(map), count(count), background(background)
+	{
+		if (background)
+			worker = std::thread([this]{ work_loop(); });
+		poll();
+	}
+
+	~landmarks_t() {
+		if (!background)
+			return ;
+		{
+			std::lock_guard<std::mutex> lock(mu);
+			stop = true;
+		}
+		cv.notify_all();
+		worker.join();
+	}
+
+	landmarks_t(const landmarks_t&) = delete;
+	landmarks_t &operator = (const landmarks_t&) = delete;
+
+	static int64_t chunk_key(int row, int col) {
+		return (int64_t(row) << 32) | uint32_t(col);
+	}
+
+	/* the tables of the chunk, NULL while they are being rebuilt */
+	const chunk_t *get_chunk(int row, int col) const {
+		if (stale || !tables)
+			return NULL;
+		auto it = tables->chunks.find(chunk_key(row, col));
+		return it == tables->chunks.end() ? NULL : &it->second;
+	}
+
+	void update_chunk(int row, int col) {
+		stale = true;
+		changes++;
+	}
+
+	/* Call once per frame: starts a rebuild if the map changed and swaps
+	in the tables of a finished one */
+	void poll() {
+		if (!background) {
+			if (stale) {
+				tables = build(take_snapshot(), count);
+				version++;
+				stale = false;
+			}
+			return ;
+		}
+		std::unique_ptr<tables_t> ready;
+		{
+			std::lock_guard<std::mutex> lock(mu);
+			ready.swap(done);
+		}
+		if (ready) {
+			building = false;
+			tables = std::move(ready);
+			version++;
+			stale = built_changes != changes;
+		}
+		if (stale && !building) {
+			building = true;
+			built_changes = changes;
+			{
+				std::lock_guard<std::mutex> lock(mu);
+				request = std::make_unique<snapshot_t>(take_snapshot());
+			}
+			cv.notify_one();
+		}
+	}
+
+	snapshot_t take_snapshot() const {
+		snapshot_t snap;
+		for (auto &&[key, chunk] : map.data) {
+			snap.keys.push_back(key);
+			snap.walk.emplace_back();
+			std::copy(chunk.walk, chunk.walk + CHK_SZ,
+					snap.walk.back().begin());
+		}
+		return snap;
+	}
+
+	void work_loop() {
+		while (true) {
+			std::unique_ptr<snapshot_t> snap;
+			{
+				std::unique_lock<std::mutex> lock(mu);
+				cv.wait(lock, [&]{ return stop || request; });
+				if (stop)
+					return ;
+				snap.swap(request);
+			}
+			auto res = build(*snap, count);
+			std::lock_guard<std::mutex> lock(mu);
+			done = std::move(res);
+		}
+	}
+
+	/* Dijkstra over the snapshot from cell src, dist is indexed by chunk index
+	* CHK_AREA + local cell */
+	static void dijkstra(const snapshot_t &snap,
+			const std::vector<std::array<int, 9>> &neigh, int src,
+			std::vector<int> &dist)
+	{
+		dist.assign(snap.keys.size() * CHK_AREA, INF);
+		std::priority_queue<std::pair<int, int>,
+				std::vector<std::pair<int, int>>,
+				std::greater<std::pair<int, int>>> que;
+		dist[src] = 0;
+		que.push({0, src});
+		while (que.size()) {
+			auto [d, id] = que.top();
+			que.pop();
+			if (d > dist[id])
+				continue ;
+			int c = id / CHK_AREA;
+			int li = id % CHK_AREA / CHK_SZ;
+			int lj = id % CHK_SZ;
+			for (int di = -1; di <= 1; di++)
+				for (int dj = -1; dj <= 1; dj++) {
+					if (!di && !dj)
+						continue ;
+					int ni = li + di;
+					int nj = lj + dj;
+					int ci = ni < 0 ? -1 : (ni >= CHK_SZ ? 1 : 0);
+					int cj = nj < 0 ? -1 : (nj >= CHK_SZ ? 1 : 0);
+					int nc = neigh[c][(ci + 1) * 3 + cj + 1];
+					if (nc < 0)
+						continue ;
+					ni -= ci * CHK_SZ;
+					nj -= cj * CHK_SZ;
+					if (!((snap.walk[nc][ni] >> nj) & 1))
+						continue ;
+					int nid = nc * CHK_AREA + ni * CHK_SZ + nj;
+					int nd = d + (di && dj ? 14 : 10);
+					if (nd < dist[nid]) {
+						dist[nid] = nd;
+						que.push({nd, nid});
+					}
+				}
+		}
+	}
+
+	static std::unique_ptr<tables_t> build(const snapshot_t &snap,
+			int count)
+	{
+		auto res = std::make_unique<tables_t>();
+		int n = snap.keys.size();
+		std::unordered_map<int64_t, int> index;
+		for (int c = 0; c < n; c++)
+			index[chunk_key(snap.keys[c].x, snap.keys[c].y)] = c;
+		std::vector<std::array<int, 9>> neigh(n);
+		for (int c = 0; c < n; c++)
+			for (int k = 0; k < 9; k++) {
+				auto it = index.find(chunk_key(snap.keys[c].x + k / 3 - 1,
+						snap.keys[c].y + k % 3 - 1));
+				neigh[c][k] = it == index.end() ? -1 : it->second;
+			}
+		for (int c = 0; c < n; c++)
+			res->chunks[chunk_key(snap.keys[c].x, snap.keys[c].y)].d.assign(
+					count * CHK_AREA, FAR);
+
+		int first = -1;
+		for (int id = 0; id < n * CHK_AREA && first < 0; id++)
+			if ((snap.walk[id / CHK_AREA][id % CHK_AREA / CHK_SZ] >>
+					(id % CHK_SZ)) & 1)
+				first = id;
+		if (first < 0)
+			return res;
+
+		/* the first landmark is the cell farthest from the first walkable
+		cell, the next ones the farthest from all the landmarks before them */
+		std::vector<int> dist;
+		dijkstra(snap, neigh, first, dist);
+		std::vector<int> closest = dist;
+		for (int k = 0; k < count; k++) {
+			int pick = first;
+			for (int id = 0; id < n * CHK_AREA; id++)
+				if (closest[id] != INF && closest[id] > closest[pick])
+					pick = id;
+			dijkstra(snap, neigh, pick, dist);
+			auto &key = snap.keys[pick / CHK_AREA];
+			res->points.push_back(Math::Point2i(
+					key.x * CHK_SZ + pick % CHK_AREA / CHK_SZ,
+					key.y * CHK_SZ + pick % CHK_SZ));
+			for (int c = 0; c < n; c++) {
+				auto &d = res->chunks[chunk_key(snap.keys[c].x,
+						snap.keys[c].y)].d;
+				for (int l = 0; l < CHK_AREA; l++) {
+					int v = dist[c * CHK_AREA + l];
+					d[k * CHK_AREA + l] = v < FAR ? v : FAR;
+				}
+			}
+			if (k == 0)
+				closest = dist;
+			else
+				for (int id = 0; id < n * CHK_AREA; id++)
+					closest[id] = std::min(closest[id], dist[id]);
+		}
+		return res;
+	}
+
+	/* bound on the cost between the cells with tables a and b, at local
+	cells la and lb */
+	int bound(const chunk_t &a, int la, const chunk_t &b, int lb) const {
+		int best = 0;
+		for (int k = 0; k < count; k++) {
+			int x = a.d[k * CHK_AREA + la];
+			int y = b.d[k * CHK_AREA + lb];
+			if (x != FAR || y != FAR)
+				best = std::max(best, abs(x - y));
+		}
+		return best;
+	}
+};
+
+#endif
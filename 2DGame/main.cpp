@@ -17,6 +17,7 @@ struct VertexColor		{ constexpr const static char name[] = "color"; };
 #include "DrawContext.h"
 #include "GameUtil.h"
 #include "pathfinding.h"
+#include "map_view.h"
 #include "camera.h"
 #include "ImGui.h"
 
@@ -38,6 +39,9 @@ do {\
 		EXCEPTION("line out of bounds");\
 } while (0);
 std::string fps_text;
+int search_mode = 0;
+int unit_size = 1;
+bool any_angle = false;
 
 struct Unit {
 	struct Draw {
@@ -178,6 +182,16 @@ static bool main_menu(bool* p_open, bool* draw_active)
 		ImGui::Text("Menu                                    ");
 		if (ImGui::Button("Create unit"))
 			*draw_active = true;
+		ImGui::RadioButton("A*", &search_mode, 0);
+		ImGui::SameLine();
+		ImGui::RadioButton("JPS", &search_mode, 1);
+		ImGui::SameLine();
+		ImGui::RadioButton("HPA*", &search_mode, 2);
+		ImGui::SameLine();
+		ImGui::RadioButton("Navmesh", &search_mode, 3);
+		ImGui::Checkbox("Any angle", &any_angle);
+		ImGui::SliderInt("Unit size", &unit_size, 1,
+				clearance_map_t::MAX_CLEARANCE);
 		if (ImGui::Button("Quit")) {
 			ImGui::End();
 			return false;
@@ -408,7 +422,25 @@ int main (int argc, char const *argv[])
 	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
 
 	bool wasLmb = false;
-	GameMap map("map.json");
+	GameMap map;
+	/* make world builds world.bin from map.json */
+	chunk_manager_t chunks(map, world_file_t::is_world("world.bin") ?
+			"world.bin" : "map.json");
+	chunks.load_now({{0, 0}});
+	clearance_map_t clearance(map);
+	connectivity_t connectivity(map, &chunks.world);
+	landmarks_t landmarks(map);
+	grid_search_t search(map, &clearance, &connectivity);
+	jps_search_t jps(map, &clearance, &connectivity);
+	hpa_search_t hpa(map);
+	navmesh_t mesh(map);
+	search.chunks = &chunks;
+	jps.chunks = &chunks;
+	search.landmarks = &landmarks;
+	jps.landmarks = &landmarks;
+	/* cells that keep their chunks loaded besides the camera, the target and
+	the start of the last path */
+	std::vector<Math::Point2i> focus = {{0, 0}, {0, 0}};
 	// auto grid = load_grid("map.txt");
 	GlFont font("/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", {32});
 	Camera camera;
@@ -447,11 +479,28 @@ int main (int argc, char const *argv[])
 		shader.setMatrix("worldMatrix",
 				translation<float>(-camera.pos.x, -camera.pos.y, 0));
 
-		map.draw(camera.pos);
+		focus.resize(2);
+		focus.push_back(camera_cell(map, camera.pos));
+		auto changed = chunks.update(focus);
+		for (auto &&key : changed) {
+			clearance.update_chunk(key.x, key.y);
+			connectivity.update_chunk(key.x, key.y);
+			hpa.update_chunk(key.x, key.y);
+			mesh.update_chunk(key.x, key.y);
+			landmarks.update_chunk(key.x, key.y);
+		}
+		landmarks.poll();
+		if (changed.size()) {
+			search.reset();
+			jps.reset();
+		}
+
+		draw_map(map, camera.pos);
 
 		static int sleep_reset = 0;
 		static std::vector<Math::Point2i> to_animate;
 		static std::vector<Math::Point2i> path;
+		static Math::Point2i path_start;
 		static std::vector<std::vector<Math::Point2i>> update_order;
 		static int animate_inc = 0;
 		static int path_inc = 0;
@@ -475,6 +524,10 @@ int main (int argc, char const *argv[])
 		glLineWidth(2);
 		for (int i = 0; i < path_inc; i++) {
 			draw_wall(path[i].x, path[i].y, SIDE, GREEN);
+			if (any_angle)
+				Util::drawLine(point_at(i ? path[i - 1].x : path_start.x,
+						i ? path[i - 1].y : path_start.y),
+						point_at(path[i].x, path[i].y), GREEN);
 		}
 		glLineWidth(1);
 		if (animate_inc != 0)
@@ -517,14 +570,26 @@ int main (int argc, char const *argv[])
 			wasLmb = false;
 			if ((mousePos - mouseStart).norm2() < 0.01) {
 				printf("clicked\n");
-				Math::Point2i a = map.get_index(mousePos + camera.pos -
-						Math::Point2f(-1, 1));
+				Math::Point2i a = get_index(map, mousePos +
+						camera.pos - Math::Point2f(-1, 1));
+				focus[1] = a;
 				to_animate = animated_fill(map, a.x, a.y);
 				// auto [visited, upd] = animated_dijkstra(map, a.y, -a.x, 0, 0);
-				auto [visited, upd, p] = animated_A_star(map, a.x, a.y, 0, 0);
+				search.size = unit_size;
+				jps.size = unit_size;
+				auto [visited, upd, p] =
+						search_mode == 1 ? animated_jps(jps, a.x, a.y, 0, 0) :
+						search_mode == 2 ? animated_hpa(hpa, a.x, a.y, 0, 0) :
+						search_mode == 3 ?
+								animated_navmesh(mesh, a.x, a.y, 0, 0) :
+						animated_A_star(search, a.x, a.y, 0, 0);
 				to_animate = visited;
 				update_order = upd;
 				path = p;
+				path_start = a;
+				if (any_angle)
+					string_pull(map, a, path, &clearance,
+							search_mode >= 2 ? 1 : unit_size);
 				animate_inc = 0;
 				path_inc = 0;
 				sleep_timer = 10;
@@ -573,8 +638,8 @@ int main (int argc, char const *argv[])
 		- maybe implement faster 2D graphics?
 		- enable target place with rmb
 		- make some props: walls, buildings etc.
-		- try to implement D*Lite
-		- try to implement FibHeap
+		+ try to implement D*Lite
+		+ try to implement FibHeap
 		- test D*Lite, FibHeap, A*, BinaryHeap
 		- D* should be able to recompute path after finding an obstacle,
 			check how well it works
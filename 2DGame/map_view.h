@@ -0,0 +1,52 @@
+#ifndef MAP_VIEW_H
+#define MAP_VIEW_H
+
+#include "draw_utils.h"
+#include "game_map.h"
+
+/* Drawing of the GameMap and the cells under the screen positions. Kept out of
+game_map.h so the map and the searches build without GL. */
+
+void draw_map(GameMap &map, Math::Point2f cam_pos) {
+	Math::Point2i pos = map.div(cam_pos + Math::Point2f(1, -1), SIDE);
+	pos.y *= -1;
+	Math::Point2i dirs[] = {
+		{-1,  1}, { 0,  1}, { 1,  1},
+		{-1,  0}, { 0,  0}, { 1,  0},
+		{-1, -1}, { 0, -1}, { 1, -1},
+	};
+
+	// drawLine();
+	draw_circle(pos.y, pos.x, SIDE, MAGENTA);
+	auto p = map.div(pos, CHK_SZ) * CHK_SZ;
+	draw_circle(p.y, p.x, SIDE, BLUE);
+
+	for (auto &&dir : dirs) {
+		auto p = map.div(pos, CHK_SZ) * CHK_SZ + dir * CHK_SZ;
+		draw_grid(p.x, -p.y, CHK_SZ, CHK_SZ);
+
+		for (int i = p.y; i < CHK_SZ + p.y; i++) {
+			auto cell = map.cursor(i, p.x);
+			for (int j = p.x; j < CHK_SZ + p.x; j++, cell.move(0, 1)) {
+				if (*cell == '#')
+					draw_wall(i, j);
+				else if (*cell != '.')
+					draw_cross(i, j);
+			}
+		}
+	}
+}
+
+/* the cell (i, j) in the middle of the view */
+Math::Point2i camera_cell(GameMap &map, Math::Point2f cam_pos) {
+	Math::Point2i pos = map.div(cam_pos + Math::Point2f(1, -1), SIDE);
+	return {-pos.y, pos.x};
+}
+
+/* the cell (i, j) under a position on the screen */
+Math::Point2i get_index(GameMap &map, Math::Point2f cursor) {
+	Math::Point2i pos = map.div(cursor, SIDE);
+	return {-pos.y - 1, pos.x};
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,357 @@
+#ifndef NAVMESH_H
+#define NAVMESH_H
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include "game_map.h"
+
+/* Navigation mesh of walkable rectangles.
+
+The walkable cells of every chunk are split in rectangles: the first free cell
+of a row starts one, it takes the whole run of walkable cells to it's right and
+grows down while the rows below have all of that run free. Runs are found with
+the walk bits of the chunk, a row of a rectangle is one mask test. Rectangles
+are linked when a cell of one is one of the 8 neighbours of a cell of the other,
+the same moves the grid searches make, across chunks too. An open chunk is a
+single rectangle instead of CHK_SZ * CHK_SZ nodes.
+
+This is a greedy split. Every rectangle is maximal among the cells left when it
+is cut, it can't grow in any direction without a wall or a cell of an earlier
+one, but not among all the walkable cells: those overlap, a split of the chunk
+into them doesn't exist in general. Cutting the largest rectangle of the cells
+left first was tried, it gave 87, 2487 and 3099 rectangles instead of 87, 2533
+and 2764 on the bench map, maze and field, and took 5 to 20 times longer to
+build, so the rows are cut in order.
+
+A search runs A* over the rectangles. Every rectangle reached remembers the
+cell it was entered at, the unit leaves it from the cell next to the following
+rectangle that is on the shortest octile way from there to the target and
+steps in the closest cell of the following rectangle. A rectangle has no
+walls, so the walk between two cells of it is a straight octile line, the cost
+of an edge is the cost of those cells and the search cost is the cost of the
+refined path. The path is kept as waypoints, refine() turns one segment at a
+time in cells, as hpa_search_t does.
+
+When the cells of a chunk change call update_chunk(), only the rectangles of
+that chunk are built again and linked to their neighbours. Chunks missing from
+the map are walls. */
+
+struct navmesh_t {
+	constexpr static int INF = 2000'000'000;
+	constexpr static int NONE = -1;
+
+	struct rect_t {
+		int i0, j0, i1, j1;
+		int64_t chunk;
+		std::vector<int> links;
+
+		Math::Point2i clamp(Math::Point2i p) const {
+			return Math::Point2i(std::clamp(p.x, i0, i1),
+					std::clamp(p.y, j0, j1));
+		}
+	};
+
+	struct chunk_t {
+		std::vector<int> rects;
+		int32_t id[CHK_SZ][CHK_SZ];
+	};
+
+	struct path_t {
+		std::vector<Math::Point2i> waypoints;
+		size_t next = 1;
+		int cost = INF;
+		bool found = false;
+
+		bool done() const {
+			return next >= waypoints.size();
+		}
+	};
+
+	GameMap &map;
+	std::vector<rect_t> rects;
+	std::vector<int> free_rects;
+	std::unordered_map<int64_t, chunk_t> data;
+	int rect_count = 0;
+
+	/* search buffers */
+	std::vector<int> dist;
+	std::vector<int> est;
+	std::vector<int> parent;
+	std::vector<Math::Point2i> entry;
+	std::vector<bool> closed;
+	std::vector<std::pair<int, int>> heap;
+	int expanded = 0;
+	size_t peak_open = 0;
+
+	navmesh_t(GameMap &map) : map(map) {
+		build();
+	}
+
+	static int64_t chunk_key(int row, int col) {
+		return (int64_t(row) << 32) | uint32_t(col);
+	}
+
+	static int floor_div(int a) {
+		return a >= 0 ? a / CHK_SZ : -((-a + CHK_SZ - 1) / CHK_SZ);
+	}
+
+	static int octile(Math::Point2i a, Math::Point2i b) {
+		int di = abs(a.x - b.x);
+		int dj = abs(a.y - b.y);
+		return di > dj ? (di - dj) * 10 + dj * 14 : (dj - di) * 10 + di * 14;
+	}
+
+	/* the rectangle of cell (i, j), NONE if it is not walkable */
+	int rect_at(int i, int j) const {
+		int row = floor_div(i);
+		int col = floor_div(j);
+		auto it = data.find(chunk_key(row, col));
+		if (it == data.end())
+			return NONE;
+		return it->second.id[i - row * CHK_SZ][j - col * CHK_SZ];
+	}
+
+	void build() {
+		rects.clear();
+		free_rects.clear();
+		data.clear();
+		rect_count = 0;
+		for (auto &&[key, chunk] : map.data)
+			split_chunk(key.x, key.y);
+		for (auto &&[key, chunk] : data)
+			for (auto &&id : chunk.rects)
+				link(id);
+	}
+
+	void update_chunk(int row, int col) {
+		remove_chunk(row, col);
+		if (!map.find_chunk(row, col))
+			return ;
+		split_chunk(row, col);
+		for (auto &&id : data[chunk_key(row, col)].rects)
+			link(id);
+	}
+
+	void remove_chunk(int row, int col) {
+		auto it = data.find(chunk_key(row, col));
+		if (it == data.end())
+			return ;
+		for (auto &&id : it->second.rects) {
+			for (auto &&oth : rects[id].links) {
+				auto &back = rects[oth].links;
+				back.erase(std::remove(back.begin(), back.end(), id),
+						back.end());
+			}
+			rects[id].links.clear();
+			free_rects.push_back(id);
+			rect_count--;
+		}
+		data.erase(it);
+	}
+
+	int new_rect() {
+		rect_count++;
+		if (free_rects.size()) {
+			int id = free_rects.back();
+			free_rects.pop_back();
+			return id;
+		}
+		rects.emplace_back();
+		return rects.size() - 1;
+	}
+
+	/* splits the walkable cells of the chunk in rectangles */
+	void split_chunk(int row, int col) {
+		auto src = map.find_chunk(row, col);
+		if (!src)
+			return ;
+		int64_t key = chunk_key(row, col);
+		auto &chunk = data[key];
+		chunk.rects.clear();
+		std::fill(&chunk.id[0][0], &chunk.id[0][0] + CHK_SZ * CHK_SZ, NONE);
+
+		uint32_t left[CHK_SZ];
+		std::copy(src->walk, src->walk + CHK_SZ, left);
+		for (int i = 0; i < CHK_SZ; i++)
+			while (left[i]) {
+				int j0 = __builtin_ctz(left[i]);
+				uint32_t run = ~(left[i] >> j0);
+				int len = run ? __builtin_ctz(run) : CHK_SZ - j0;
+				uint32_t mask = (len == CHK_SZ ? ~0u : (1u << len) - 1) << j0;
+				int i1 = i;
+				while (i1 + 1 < CHK_SZ && (left[i1 + 1] & mask) == mask)
+					i1++;
+
+				int id = new_rect();
+				auto &r = rects[id];
+				r.i0 = row * CHK_SZ + i;
+				r.j0 = col * CHK_SZ + j0;
+				r.i1 = row * CHK_SZ + i1;
+				r.j1 = col * CHK_SZ + j0 + len - 1;
+				r.chunk = key;
+				r.links.clear();
+				chunk.rects.push_back(id);
+				for (int k = i; k <= i1; k++) {
+					left[k] &= ~mask;
+					for (int j = j0; j < j0 + len; j++)
+						chunk.id[k][j] = id;
+				}
+			}
+	}
+
+	void add_link(int a, int b) {
+		auto &links = rects[a].links;
+		if (std::find(links.begin(), links.end(), b) != links.end())
+			return ;
+		links.push_back(b);
+		rects[b].links.push_back(a);
+	}
+
+	/* links the rectangle with the ones around it, the ring of cells just
+	outside it is looked up */
+	void link(int id) {
+		auto &r = rects[id];
+		for (int i = r.i0 - 1; i <= r.i1 + 1; i++) {
+			bool edge = i == r.i0 - 1 || i == r.i1 + 1;
+			for (int j = r.j0 - 1; j <= r.j1 + 1; j += edge ? 1 :
+					r.j1 - r.j0 + 2)
+			{
+				int oth = rect_at(i, j);
+				if (oth != NONE && oth != id)
+					add_link(id, oth);
+			}
+		}
+	}
+
+	/* Where a unit at p in rectangle a leaves it for the neighbour b, when
+	heading for target. out is the last cell in a, in the first one in b. The
+	cells of a next to b are a line, the cost along it only bends where one
+	of the octile distances does, so only those cells are tried */
+	void crossing(int a, int b, Math::Point2i p, Math::Point2i target,
+			Math::Point2i &out, Math::Point2i &in) const
+	{
+		auto &ra = rects[a];
+		auto &rb = rects[b];
+		int i0 = std::max(ra.i0, rb.i0 - 1), i1 = std::min(ra.i1, rb.i1 + 1);
+		int j0 = std::max(ra.j0, rb.j0 - 1), j1 = std::min(ra.j1, rb.j1 + 1);
+		int best = INF;
+		auto test = [&](int i, int j) {
+			Math::Point2i o(std::clamp(i, i0, i1), std::clamp(j, j0, j1));
+			auto n = rb.clamp(o);
+			int cost = octile(p, o) + octile(o, n) + octile(n, target);
+			if (cost < best) {
+				best = cost;
+				out = o;
+				in = n;
+			}
+		};
+		if (i0 == i1) {
+			int dp = abs(i0 - p.x);
+			int dt = abs(rb.clamp(Math::Point2i(i0, j0)).x - target.x);
+			for (int j : {j0, j1, rb.j0, rb.j1, p.y, p.y - dp, p.y + dp,
+					target.y, target.y - dt, target.y + dt})
+				test(i0, j);
+		}
+		else {
+			int dp = abs(j0 - p.y);
+			int dt = abs(rb.clamp(Math::Point2i(i0, j0)).y - target.y);
+			for (int i : {i0, i1, rb.i0, rb.i1, p.x, p.x - dp, p.x + dp,
+					target.x, target.x - dt, target.x + dt})
+				test(i, j0);
+		}
+	}
+
+	/* A* over the rectangles from (si, sj) to (ti, tj), fills path with the
+	waypoints: the start, the two cells of every crossing and the target */
+	bool find(int si, int sj, int ti, int tj, path_t &path) {
+		path = path_t();
+		expanded = 0;
+		peak_open = 0;
+		Math::Point2i target(ti, tj);
+		int src = rect_at(si, sj);
+		int dst = rect_at(ti, tj);
+		if (src == NONE || dst == NONE)
+			return false;
+
+		int n = rects.size();
+		dist.assign(n, INF);
+		est.assign(n, INF);
+		parent.assign(n, NONE);
+		entry.assign(n, Math::Point2i());
+		closed.assign(n, false);
+		heap.clear();
+
+		dist[src] = 0;
+		entry[src] = Math::Point2i(si, sj);
+		est[src] = octile(entry[src], target);
+		heap.push_back({est[src], src});
+		while (heap.size()) {
+			std::pop_heap(heap.begin(), heap.end(), std::greater<>());
+			int id = heap.back().second;
+			heap.pop_back();
+			if (closed[id])
+				continue ;
+			closed[id] = true;
+			if (id == dst)
+				break ;
+			expanded++;
+
+			for (auto &&oth : rects[id].links) {
+				if (closed[oth])
+					continue ;
+				Math::Point2i out, in;
+				crossing(id, oth, entry[id], target, out, in);
+				/* rectangles are entered at different cells, so the
+				estimates are compared instead of the costs so far */
+				int nd = dist[id] + octile(entry[id], out) + octile(out, in);
+				int f = nd + octile(in, target);
+				if (f < est[oth]) {
+					dist[oth] = nd;
+					est[oth] = f;
+					parent[oth] = id;
+					entry[oth] = in;
+					heap.push_back({f, oth});
+					std::push_heap(heap.begin(), heap.end(), std::greater<>());
+					peak_open = std::max(peak_open, heap.size());
+				}
+			}
+		}
+		if (est[dst] == INF)
+			return false;
+
+		path.waypoints.push_back(target);
+		for (int id = dst; parent[id] != NONE; id = parent[id]) {
+			Math::Point2i out, in;
+			crossing(parent[id], id, entry[parent[id]], target, out,
+					in);
+			path.waypoints.push_back(in);
+			path.waypoints.push_back(out);
+		}
+		path.waypoints.push_back(entry[src]);
+		std::reverse(path.waypoints.begin(), path.waypoints.end());
+		path.cost = dist[dst] + octile(entry[dst], target);
+		path.found = true;
+		return true;
+	}
+
+	/* Appends the cells from the next waypoint segment of path to cells, the
+	segment is a straight octile walk. Returns false once the whole path has
+	been refined. */
+	bool refine(path_t &path, std::vector<Math::Point2i> &cells) {
+		if (path.done())
+			return false;
+		auto a = path.waypoints[path.next - 1];
+		auto b = path.waypoints[path.next];
+		path.next++;
+		while (!(a == b)) {
+			a.x += (b.x > a.x) - (b.x < a.x);
+			a.y += (b.y > a.y) - (b.y < a.y);
+			cells.push_back(a);
+		}
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,588 @@
+#ifndef PRIORITY_QUEUES_H
+#define PRIORITY_QUEUES_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+/* Open lists for the grid searches.
+
+Every queue has the same interface, so a search can take any of them as a
+template parameter:
+
+	void clear();
+	bool empty() const;
+	size_t size() const;
+	void push(int f, int h, int id);	inserts id, or lowers it's key if id
+										is already queued with a bigger one
+	int pop();							removes the id with the smallest key
+
+Ids are the node ids of the search, a queue keeps where each queued id is so
+decrease-key doesn't need duplicates in the queue. The heaps order by f and
+then by h, like the old open list did. The bucket and radix queues only look
+at f and need monotone keys: nothing smaller than the last popped f can be
+pushed, which holds for A* and JPS with the octile heuristic and for Dijkstra. */
+
+/* id -> int table that grows on demand, NONE for ids that aren't queued */
+struct queue_handles_t {
+	constexpr static int NONE = -1;
+	std::vector<int> v;
+
+	int get(int id) const {
+		return id < v.size() ? v[id] : NONE;
+	}
+
+	void set(int id, int val) {
+		if (id >= v.size())
+			v.resize(std::max<size_t>(id + 1, v.size() * 2), NONE);
+		v[id] = val;
+	}
+};
+
+inline bool queue_less(int f1, int h1, int f2, int h2) {
+	return f1 != f2 ? f1 < f2 : h1 < h2;
+}
+
+struct binary_heap_t {
+	struct item_t {
+		int f;
+		int h;
+		int id;
+	};
+
+	std::vector<item_t> heap;
+	queue_handles_t where;
+
+	void clear() {
+		for (auto &&item : heap)
+			where.set(item.id, queue_handles_t::NONE);
+		heap.clear();
+	}
+
+	bool empty() const {
+		return heap.empty();
+	}
+
+	size_t size() const {
+		return heap.size();
+	}
+
+	bool less(const item_t &a, const item_t &b) const {
+		return queue_less(a.f, a.h, b.f, b.h);
+	}
+
+	void place(int pos, const item_t &item) {
+		heap[pos] = item;
+		where.set(item.id, pos);
+	}
+
+	void sift_up(int pos) {
+		item_t item = heap[pos];
+		while (pos > 0 && less(item, heap[(pos - 1) / 2])) {
+			place(pos, heap[(pos - 1) / 2]);
+			pos = (pos - 1) / 2;
+		}
+		place(pos, item);
+	}
+
+	void sift_down(int pos) {
+		item_t item = heap[pos];
+		int size = heap.size();
+		while (2 * pos + 1 < size) {
+			int child = 2 * pos + 1;
+			if (child + 1 < size && less(heap[child + 1], heap[child]))
+				child++;
+			if (!less(heap[child], item))
+				break;
+			place(pos, heap[child]);
+			pos = child;
+		}
+		place(pos, item);
+	}
+
+	void push(int f, int h, int id) {
+		int pos = where.get(id);
+		if (pos == queue_handles_t::NONE) {
+			heap.push_back({f, h, id});
+			sift_up(heap.size() - 1);
+		}
+		else if (queue_less(f, h, heap[pos].f, heap[pos].h)) {
+			heap[pos].f = f;
+			heap[pos].h = h;
+			sift_up(pos);
+		}
+	}
+
+	int pop() {
+		int id = heap[0].id;
+		where.set(id, queue_handles_t::NONE);
+		if (heap.size() > 1) {
+			place(0, heap.back());
+			heap.pop_back();
+			sift_down(0);
+		}
+		else {
+			heap.pop_back();
+		}
+		return id;
+	}
+};
+
+/* Dial's buckets, one per f value, kept in a ring that grows when the keys
+in the queue spread over more values than it has buckets. Inside a bucket the
+last pushed id comes out first */
+struct bucket_queue_t {
+	std::vector<std::vector<int>> buckets = std::vector<std::vector<int>>(32);
+	queue_handles_t where;
+	queue_handles_t key;
+	int lo = 0;
+	int hi = 0;
+	int count = 0;
+
+	void clear() {
+		for (auto &&bucket : buckets) {
+			for (auto &&id : bucket)
+				where.set(id, queue_handles_t::NONE);
+			bucket.clear();
+		}
+		count = 0;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+	size_t size() const {
+		return count;
+	}
+
+	std::vector<int> &bucket(int f) {
+		return buckets[f & (buckets.size() - 1)];
+	}
+
+	void grow(int span) {
+		size_t size = buckets.size();
+		while (size < span)
+			size *= 2;
+		std::vector<std::vector<int>> old(size);
+		old.swap(buckets);
+		for (auto &&b : old)
+			for (auto &&id : b) {
+				where.set(id, bucket(key.get(id)).size());
+				bucket(key.get(id)).push_back(id);
+			}
+	}
+
+	void remove(int id) {
+		auto &b = bucket(key.get(id));
+		int pos = where.get(id);
+		where.set(b.back(), pos);
+		b[pos] = b.back();
+		b.pop_back();
+		where.set(id, queue_handles_t::NONE);
+		count--;
+	}
+
+	void push(int f, int h, int id) {
+		if (where.get(id) != queue_handles_t::NONE) {
+			if (f >= key.get(id))
+				return ;
+			remove(id);
+		}
+		if (count == 0) {
+			lo = hi = f;
+		}
+		else {
+			lo = std::min(lo, f);
+			hi = std::max(hi, f);
+		}
+		if (hi - lo + 1 > buckets.size())
+			grow(hi - lo + 1);
+		key.set(id, f);
+		where.set(id, bucket(f).size());
+		bucket(f).push_back(id);
+		count++;
+	}
+
+	int pop() {
+		while (bucket(lo).empty())
+			lo++;
+		int id = bucket(lo).back();
+		bucket(lo).pop_back();
+		where.set(id, queue_handles_t::NONE);
+		count--;
+		return id;
+	}
+};
+
+/* Radix heap: bucket k holds the keys that first differ from the last popped
+key at bit k - 1, bucket 0 the keys equal to it. Only the smallest non empty
+bucket is ever split, each key moves down at most 32 times */
+struct radix_heap_t {
+	constexpr static int BUCKETS = 33;
+
+	std::vector<int> buckets[BUCKETS];
+	/* the bucket being split, swapped with it so both keep their storage */
+	std::vector<int> moved;
+	queue_handles_t where;
+	queue_handles_t in_bucket;
+	queue_handles_t key;
+	int last = 0;
+	int count = 0;
+
+	void clear() {
+		for (auto &&bucket : buckets) {
+			for (auto &&id : bucket)
+				where.set(id, queue_handles_t::NONE);
+			bucket.clear();
+		}
+		last = 0;
+		count = 0;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+	size_t size() const {
+		return count;
+	}
+
+	int bucket_of(int f) const {
+		return f == last ? 0 : 32 - __builtin_clz(uint32_t(f ^ last));
+	}
+
+	void insert(int id, int f) {
+		int b = bucket_of(f);
+		key.set(id, f);
+		in_bucket.set(id, b);
+		where.set(id, buckets[b].size());
+		buckets[b].push_back(id);
+	}
+
+	void remove(int id) {
+		auto &b = buckets[in_bucket.get(id)];
+		int pos = where.get(id);
+		where.set(b.back(), pos);
+		b[pos] = b.back();
+		b.pop_back();
+		where.set(id, queue_handles_t::NONE);
+	}
+
+	void push(int f, int h, int id) {
+		if (count == 0 && f < last)
+			last = f;
+		if (where.get(id) != queue_handles_t::NONE) {
+			if (f >= key.get(id))
+				return ;
+			remove(id);
+			count--;
+		}
+		insert(id, std::max(f, last));
+		count++;
+	}
+
+	int pop() {
+		if (buckets[0].empty()) {
+			int b = 1;
+			while (buckets[b].empty())
+				b++;
+			int lowest = key.get(buckets[b][0]);
+			for (auto &&id : buckets[b])
+				lowest = std::min(lowest, key.get(id));
+			last = lowest;
+			moved.swap(buckets[b]);
+			for (auto &&id : moved)
+				insert(id, key.get(id));
+			moved.clear();
+		}
+		int id = buckets[0].back();
+		buckets[0].pop_back();
+		where.set(id, queue_handles_t::NONE);
+		count--;
+		return id;
+	}
+};
+
+/* Pairing heap over a node pool, decrease-key cuts the node and melds it
+back with the root */
+struct pairing_heap_t {
+	constexpr static int NONE = -1;
+
+	struct node_t {
+		int f;
+		int h;
+		int id;
+		int child;
+		int next;
+		int prev;
+	};
+
+	std::vector<node_t> nodes;
+	std::vector<int> pairs;
+	queue_handles_t where;
+	int root = NONE;
+	int count = 0;
+
+	void clear() {
+		for (auto &&n : nodes)
+			where.set(n.id, queue_handles_t::NONE);
+		nodes.clear();
+		root = NONE;
+		count = 0;
+	}
+
+	bool empty() const {
+		return root == NONE;
+	}
+
+	size_t size() const {
+		return count;
+	}
+
+	bool less(int a, int b) const {
+		return queue_less(nodes[a].f, nodes[a].h, nodes[b].f, nodes[b].h);
+	}
+
+	int meld(int a, int b) {
+		if (a == NONE)
+			return b;
+		if (b == NONE)
+			return a;
+		if (less(b, a))
+			std::swap(a, b);
+		nodes[b].prev = a;
+		nodes[b].next = nodes[a].child;
+		if (nodes[a].child != NONE)
+			nodes[nodes[a].child].prev = b;
+		nodes[a].child = b;
+		nodes[a].next = NONE;
+		nodes[a].prev = NONE;
+		return a;
+	}
+
+	void cut(int n) {
+		auto &node = nodes[n];
+		if (nodes[node.prev].child == n)
+			nodes[node.prev].child = node.next;
+		else
+			nodes[node.prev].next = node.next;
+		if (node.next != NONE)
+			nodes[node.next].prev = node.prev;
+		node.next = NONE;
+		node.prev = NONE;
+	}
+
+	void push(int f, int h, int id) {
+		int n = where.get(id);
+		if (n == queue_handles_t::NONE) {
+			n = nodes.size();
+			nodes.push_back({f, h, id, NONE, NONE, NONE});
+			where.set(id, n);
+			root = meld(root, n);
+			count++;
+		}
+		else if (queue_less(f, h, nodes[n].f, nodes[n].h)) {
+			nodes[n].f = f;
+			nodes[n].h = h;
+			if (n != root) {
+				cut(n);
+				root = meld(root, n);
+			}
+		}
+	}
+
+	/* the children are melded in pairs left to right, then the pairs are
+	melded right to left */
+	int pop() {
+		int top = root;
+		where.set(nodes[top].id, queue_handles_t::NONE);
+		count--;
+		pairs.clear();
+		for (int c = nodes[top].child; c != NONE; ) {
+			int a = c;
+			int b = nodes[a].next;
+			c = b == NONE ? NONE : nodes[b].next;
+			nodes[a].next = nodes[a].prev = NONE;
+			if (b != NONE)
+				nodes[b].next = nodes[b].prev = NONE;
+			pairs.push_back(meld(a, b));
+		}
+		root = NONE;
+		for (int i = int(pairs.size()) - 1; i >= 0; i--)
+			root = meld(pairs[i], root);
+		return nodes[top].id;
+	}
+};
+
+/* Fibonacci heap over a node pool, roots and children are kept in circular
+doubly linked lists */
+struct fibonacci_heap_t {
+	constexpr static int NONE = -1;
+
+	struct node_t {
+		int f;
+		int h;
+		int id;
+		int parent;
+		int child;
+		int left;
+		int right;
+		int degree;
+		bool mark;
+	};
+
+	std::vector<node_t> nodes;
+	std::vector<int> by_degree;
+	std::vector<int> roots;
+	queue_handles_t where;
+	int min = NONE;
+	int count = 0;
+
+	void clear() {
+		for (auto &&n : nodes)
+			where.set(n.id, queue_handles_t::NONE);
+		nodes.clear();
+		min = NONE;
+		count = 0;
+	}
+
+	bool empty() const {
+		return count == 0;
+	}
+
+	size_t size() const {
+		return count;
+	}
+
+	bool less(int a, int b) const {
+		return queue_less(nodes[a].f, nodes[a].h, nodes[b].f, nodes[b].h);
+	}
+
+	/* puts the single node n in the list next to pos */
+	void splice(int pos, int n) {
+		nodes[n].left = pos;
+		nodes[n].right = nodes[pos].right;
+		nodes[nodes[pos].right].left = n;
+		nodes[pos].right = n;
+	}
+
+	void unlink(int n) {
+		nodes[nodes[n].left].right = nodes[n].right;
+		nodes[nodes[n].right].left = nodes[n].left;
+		nodes[n].left = nodes[n].right = n;
+	}
+
+	void add_root(int n) {
+		nodes[n].parent = NONE;
+		nodes[n].mark = false;
+		if (min == NONE) {
+			nodes[n].left = nodes[n].right = n;
+			min = n;
+			return ;
+		}
+		splice(min, n);
+		if (less(n, min))
+			min = n;
+	}
+
+	void push(int f, int h, int id) {
+		int n = where.get(id);
+		if (n == queue_handles_t::NONE) {
+			n = nodes.size();
+			nodes.push_back({f, h, id, NONE, NONE, n, n, 0, false});
+			where.set(id, n);
+			add_root(n);
+			count++;
+			return ;
+		}
+		if (!queue_less(f, h, nodes[n].f, nodes[n].h))
+			return ;
+		nodes[n].f = f;
+		nodes[n].h = h;
+		int p = nodes[n].parent;
+		if (p != NONE && less(n, p)) {
+			cut(n, p);
+			while (nodes[p].parent != NONE) {
+				if (!nodes[p].mark) {
+					nodes[p].mark = true;
+					break;
+				}
+				int pp = nodes[p].parent;
+				cut(p, pp);
+				p = pp;
+			}
+		}
+		if (less(n, min))
+			min = n;
+	}
+
+	void cut(int n, int p) {
+		if (nodes[p].child == n)
+			nodes[p].child = nodes[n].right == n ? NONE : nodes[n].right;
+		unlink(n);
+		nodes[p].degree--;
+		add_root(n);
+	}
+
+	void link(int child, int parent) {
+		unlink(child);
+		nodes[child].parent = parent;
+		nodes[child].mark = false;
+		if (nodes[parent].child == NONE)
+			nodes[parent].child = child;
+		else
+			splice(nodes[parent].child, child);
+		nodes[parent].degree++;
+	}
+
+	int pop() {
+		int top = min;
+		where.set(nodes[top].id, queue_handles_t::NONE);
+		count--;
+
+		for (int c = nodes[top].child; c != NONE; ) {
+			int next = nodes[c].right == c ? NONE : nodes[c].right;
+			unlink(c);
+			nodes[c].parent = NONE;
+			splice(top, c);
+			c = next;
+		}
+		nodes[top].child = NONE;
+
+		roots.clear();
+		for (int r = nodes[top].right; r != top; r = nodes[r].right)
+			roots.push_back(r);
+		unlink(top);
+		min = NONE;
+		by_degree.assign(by_degree.size(), NONE);
+		for (auto r : roots) {
+			nodes[r].parent = NONE;
+			while (true) {
+				int d = nodes[r].degree;
+				if (d >= by_degree.size())
+					by_degree.resize(d + 1, NONE);
+				int other = by_degree[d];
+				if (other == NONE) {
+					by_degree[d] = r;
+					break;
+				}
+				by_degree[d] = NONE;
+				if (less(other, r))
+					std::swap(other, r);
+				link(other, r);
+			}
+		}
+		for (auto r : by_degree) {
+			if (r == NONE)
+				continue ;
+			nodes[r].left = nodes[r].right = r;
+		}
+		for (auto r : by_degree)
+			if (r != NONE)
+				add_root(r);
+		return nodes[top].id;
+	}
+};
+
+#endif
@@ -1,6 +1,488 @@
 #ifndef TEST_PATHFINDING_H
 #define TEST_PATHFINDING_H
 
+#include <array>
+#include <chrono>
+#include <random>
+#include "pathfinding.h"
 
+/* Pathfinding benchmarks.
 
-#endif
\ No newline at end of file
+A scenario is a map, either loaded from map.json or generated (mazes and open
+fields with random walls). Every scenario has a fixed query set, between the
+walkable cells closest to the corners and the center of the map, and a random
+one. Each planner runs on every set and gets one row in the results: found
+paths, nodes expanded, peak open list size, bytes allocated (the bench binary
+counts them in operator new), build and query times and the path costs
+compared with Dijkstra. The fill rows time the bit flood against a flood
+that looks every cell up in the map. The path rows compare the waypoints of the
+A* paths with the corners left by string_pull(), their cost is the length of
+the any angle path and their time is the time of the pulling. For HPA* the
+nodes and the open list are the ones of the abstract graph, for the navmesh the
+ones of the rectangles. rows_to_csv() writes the rows so runs can be diffed.
+
+check_rows() fails a run where a planner found a path cheaper than Dijkstra,
+which is a bug, or more than bound times as expensive. The grid searches are
+exact, their bound is 1. HPA* and the navmesh don't promise optimal paths,
+their bounds are the worst ratios seen on this corpus with some room, so only
+a regression fails them. Any angle paths are shorter than grid paths and are
+not checked. */
+
+using query_t = std::array<int, 4>;
+
+size_t bench_alloc_bytes = 0;
+
+constexpr double HPA_BOUND = 3;
+constexpr double NAVMESH_BOUND = 1.5;
+
+struct bench_row_t {
+	std::string scenario;
+	std::string set;
+	std::string planner;
+	int queries = 0;
+	int found = 0;
+	long long expanded = 0;
+	size_t peak_open = 0;
+	size_t bytes = 0;
+	double build_us = 0;
+	double query_us = 0;
+	int compared = 0;
+	double cost_ratio = 0;
+	double min_cost_ratio = 0;
+	double max_cost_ratio = 0;
+	/* the largest cost ratio allowed, 0 if the costs aren't checked */
+	double bound = 0;
+	long long waypoints = 0;
+
+	void add_ratio(double ratio) {
+		min_cost_ratio = compared ? std::min(min_cost_ratio, ratio) : ratio;
+		max_cost_ratio = std::max(max_cost_ratio, ratio);
+		cost_ratio += ratio;
+		compared++;
+	}
+};
+
+/* rows x cols chunks with wall_pct percent of the cells taken by walls */
+void generate_open_field(GameMap &map, int rows, int cols, int wall_pct,
+		int seed)
+{
+	std::mt19937 rng(seed);
+	for (int i = 0; i < rows * CHK_SZ; i++)
+		for (int j = 0; j < cols * CHK_SZ; j++)
+			map.set(i, j, rng() % 100 < wall_pct ? '#' : '.');
+}
+
+/* rows x cols chunks of maze with corridors one cell wide, dug with a depth
+first search from a random cell on the odd coordinates */
+void generate_maze(GameMap &map, int rows, int cols, int seed) {
+	std::mt19937 rng(seed);
+	int h = rows * CHK_SZ;
+	int w = cols * CHK_SZ;
+	for (int i = 0; i < h; i++)
+		for (int j = 0; j < w; j++)
+			map.set(i, j, '#');
+
+	std::vector<bool> seen(h * w);
+	std::vector<Math::Point2i> stack;
+	Math::Point2i first(1 + 2 * (rng() % ((h - 1) / 2)),
+			1 + 2 * (rng() % ((w - 1) / 2)));
+	stack.push_back(first);
+	seen[first.x * w + first.y] = true;
+	map.set(first.x, first.y, '.');
+	Math::Point2i dirs[] = {{-2, 0}, {2, 0}, {0, -2}, {0, 2}};
+	while (stack.size()) {
+		auto cur = stack.back();
+		Math::Point2i options[4];
+		int cnt = 0;
+		for (auto &&d : dirs) {
+			auto next = cur + d;
+			if (next.x < 1 || next.y < 1 || next.x >= h - 1 || next.y >= w - 1)
+				continue ;
+			if (!seen[next.x * w + next.y])
+				options[cnt++] = next;
+		}
+		if (!cnt) {
+			stack.pop_back();
+			continue ;
+		}
+		auto next = options[rng() % cnt];
+		seen[next.x * w + next.y] = true;
+		map.set((cur.x + next.x) / 2, (cur.y + next.y) / 2, '.');
+		map.set(next.x, next.y, '.');
+		stack.push_back(next);
+	}
+}
+
+std::vector<Math::Point2i> walkable_cells(GameMap &map) {
+	std::vector<Math::Point2i> cells;
+	for (auto &&chunk : map.data)
+		for (int i = 0; i < CHK_SZ; i++)
+			for (int j = 0; j < CHK_SZ; j++)
+				if (chunk.second.m[i][j] == '.')
+					cells.push_back({chunk.first.x * CHK_SZ + i,
+							chunk.first.y * CHK_SZ + j});
+	std::sort(cells.begin(), cells.end());
+	return cells;
+}
+
+/* pairs of random walkable cells, the same for every planner */
+std::vector<query_t> random_queries(GameMap &map, int count, int seed = 1) {
+	auto cells = walkable_cells(map);
+	std::vector<query_t> queries;
+	if (cells.empty())
+		return queries;
+	std::mt19937 rng(seed);
+	for (int k = 0; k < count; k++) {
+		auto &a = cells[rng() % cells.size()];
+		auto &b = cells[rng() % cells.size()];
+		queries.push_back({a.x, a.y, b.x, b.y});
+	}
+	return queries;
+}
+
+/* all the pairs between the cells closest to the corners and the center of
+the map */
+std::vector<query_t> fixed_queries(GameMap &map) {
+	auto cells = walkable_cells(map);
+	std::vector<query_t> queries;
+	if (cells.empty())
+		return queries;
+	int lo_i = INT_MAX, lo_j = INT_MAX, hi_i = INT_MIN, hi_j = INT_MIN;
+	for (auto &&c : cells) {
+		lo_i = std::min(lo_i, c.x);
+		lo_j = std::min(lo_j, c.y);
+		hi_i = std::max(hi_i, c.x);
+		hi_j = std::max(hi_j, c.y);
+	}
+	Math::Point2i marks[] = {{lo_i, lo_j}, {lo_i, hi_j}, {hi_i, lo_j},
+			{hi_i, hi_j}, {(lo_i + hi_i) / 2, (lo_j + hi_j) / 2}};
+	std::vector<Math::Point2i> points;
+	for (auto &&m : marks) {
+		auto best = cells[0];
+		for (auto &&c : cells)
+			if (abs(c.x - m.x) + abs(c.y - m.y) <
+					abs(best.x - m.x) + abs(best.y - m.y))
+				best = c;
+		points.push_back(best);
+	}
+	for (auto &&a : points)
+		for (auto &&b : points)
+			if (!(a == b))
+				queries.push_back({a.x, a.y, b.x, b.y});
+	return queries;
+}
+
+/* Dijkstra costs of the queries, -1 where there is no path */
+std::vector<int> reference_costs(GameMap &map,
+		const std::vector<query_t> &queries)
+{
+	std::vector<int> costs;
+	grid_search_t search(map);
+	for (auto &&q : queries)
+		costs.push_back(search.search(q[0], q[1], q[2], q[3], false) ?
+				search.cost() : -1);
+	return costs;
+}
+
+/* grid engine with landmark tables built when it is, so the build time of the
+tables is in the build time of the row */
+template <typename base_t>
+struct alt_engine_t : base_t {
+	landmarks_t tables;
+
+	alt_engine_t(GameMap &map)
+	: base_t(map), tables(map, landmarks_t::DEFAULT_COUNT, false) {
+		this->landmarks = &tables;
+	}
+};
+
+/* query_fn(engine, query, cost) runs one query, returns true if a path was
+found and it's cost in cost */
+template <typename engine_t, typename query_fn_t>
+bench_row_t bench_planner(const char *name, GameMap &map,
+		const std::vector<query_t> &queries, const std::vector<int> &costs,
+		query_fn_t query_fn, double bound = 1)
+{
+	using clock = std::chrono::steady_clock;
+	bench_row_t row;
+	row.planner = name;
+	row.queries = queries.size();
+	row.bound = bound;
+
+	size_t bytes = bench_alloc_bytes;
+	auto start = clock::now();
+	engine_t engine(map);
+	auto built = clock::now();
+	for (int k = 0; k < queries.size(); k++) {
+		int cost = -1;
+		bool found = query_fn(engine, queries[k], cost);
+		row.found += found;
+		row.expanded += engine.expanded;
+		row.peak_open = std::max(row.peak_open, engine.peak_open);
+		if (found && costs[k] > 0)
+			row.add_ratio(double(cost) / costs[k]);
+	}
+	auto end = clock::now();
+	row.bytes = bench_alloc_bytes - bytes;
+	row.build_us = std::chrono::duration<double, std::micro>(
+			built - start).count();
+	row.query_us = std::chrono::duration<double, std::micro>(
+			end - built).count();
+	if (row.compared)
+		row.cost_ratio /= row.compared;
+	return row;
+}
+
+template <typename engine_t>
+bench_row_t bench_grid(const char *name, GameMap &map,
+		const std::vector<query_t> &queries, const std::vector<int> &costs)
+{
+	return bench_planner<engine_t>(name, map, queries, costs,
+			[](engine_t &engine, const query_t &q, int &cost) {
+				bool found = engine.search(q[0], q[1], q[2], q[3]);
+				cost = engine.cost();
+				return found;
+			});
+}
+
+std::vector<bench_row_t> bench_set(GameMap &map,
+		const std::vector<query_t> &queries)
+{
+	auto costs = reference_costs(map, queries);
+	std::vector<bench_row_t> rows;
+	rows.push_back(bench_planner<grid_search_t>("dijkstra", map, queries,
+			costs, [](grid_search_t &engine, const query_t &q, int &cost) {
+				bool found = engine.search(q[0], q[1], q[2], q[3], false);
+				cost = engine.cost();
+				return found;
+			}));
+	rows.push_back(bench_grid<basic_grid_search_t<binary_heap_t>>(
+			"A*/binary", map, queries, costs));
+	rows.push_back(bench_grid<basic_grid_search_t<bucket_queue_t>>(
+			"A*/bucket", map, queries, costs));
+	rows.push_back(bench_grid<basic_grid_search_t<radix_heap_t>>(
+			"A*/radix", map, queries, costs));
+	rows.push_back(bench_grid<basic_grid_search_t<pairing_heap_t>>(
+			"A*/pairing", map, queries, costs));
+	rows.push_back(bench_grid<basic_grid_search_t<fibonacci_heap_t>>(
+			"A*/fibonacci", map, queries, costs));
+	rows.push_back(bench_grid<alt_engine_t<grid_search_t>>(
+			"A*/alt", map, queries, costs));
+	rows.push_back(bench_grid<basic_jps_search_t<binary_heap_t>>(
+			"JPS/binary", map, queries, costs));
+	rows.push_back(bench_grid<basic_jps_search_t<bucket_queue_t>>(
+			"JPS/bucket", map, queries, costs));
+	rows.push_back(bench_grid<basic_jps_search_t<radix_heap_t>>(
+			"JPS/radix", map, queries, costs));
+	rows.push_back(bench_grid<alt_engine_t<jps_search_t>>(
+			"JPS/alt", map, queries, costs));
+	rows.push_back(bench_planner<hpa_search_t>("HPA*", map, queries, costs,
+			[](hpa_search_t &engine, const query_t &q, int &cost) {
+				hpa_search_t::path_t path;
+				std::vector<Math::Point2i> cells;
+				if (!engine.find(q[0], q[1], q[2], q[3], path))
+					return false;
+				while (engine.refine(path, cells))
+					;
+				cost = path.cost;
+				return true;
+			}, HPA_BOUND));
+	rows.push_back(bench_planner<navmesh_t>("navmesh", map, queries, costs,
+			[](navmesh_t &engine, const query_t &q, int &cost) {
+				navmesh_t::path_t path;
+				std::vector<Math::Point2i> cells;
+				if (!engine.find(q[0], q[1], q[2], q[3], path))
+					return false;
+				while (engine.refine(path, cells))
+					;
+				cost = path.cost;
+				return true;
+			}, NAVMESH_BOUND));
+	return rows;
+}
+
+/* Reference flood, one hash lookup per cell, the way animated_fill used to
+walk the map */
+int cell_fill(GameMap &map, int i, int j) {
+	auto walkable = [&](int i, int j) {
+		int row = bit_flood_t::floor_div(i);
+		int col = bit_flood_t::floor_div(j);
+		auto it = map.data.find(GameMap::key_t(row, col));
+		return it != map.data.end() &&
+				it->second.walkable(i - row * CHK_SZ, j - col * CHK_SZ);
+	};
+	if (!walkable(i, j))
+		return 0;
+	std::unordered_map<int64_t, bool> visited;
+	std::vector<Math::Point2i> to_walk = {{i, j}};
+	visited[bit_flood_t::chunk_key(i, j)] = true;
+	for (size_t k = 0; k < to_walk.size(); k++) {
+		auto elem = to_walk[k];
+		for (int di = -1; di <= 1; di++)
+			for (int dj = -1; dj <= 1; dj++) {
+				Math::Point2i neigh(elem.x + di, elem.y + dj);
+				if (!walkable(neigh.x, neigh.y))
+					continue ;
+				auto &seen = visited[bit_flood_t::chunk_key(neigh.x, neigh.y)];
+				if (!seen) {
+					seen = true;
+					to_walk.push_back(neigh);
+				}
+			}
+	}
+	return to_walk.size();
+}
+
+/* Floods from the start of every query with both fills. expanded is the
+number of reached cells and found counts the floods where the bit flood
+reached as many cells as the reference. */
+std::vector<bench_row_t> bench_fill(GameMap &map,
+		const std::vector<query_t> &queries)
+{
+	using clock = std::chrono::steady_clock;
+	std::vector<int> reference;
+	bench_row_t cells, bits;
+	cells.planner = "fill/cells";
+	bits.planner = "fill/bits";
+	cells.queries = bits.queries = queries.size();
+
+	size_t bytes = bench_alloc_bytes;
+	auto start = clock::now();
+	for (auto &&q : queries) {
+		reference.push_back(cell_fill(map, q[0], q[1]));
+		cells.expanded += reference.back();
+	}
+	cells.found = queries.size();
+	cells.query_us = std::chrono::duration<double, std::micro>(
+			clock::now() - start).count();
+	cells.bytes = bench_alloc_bytes - bytes;
+
+	bytes = bench_alloc_bytes;
+	start = clock::now();
+	bit_flood_t fill(map);
+	for (int k = 0; k < queries.size(); k++) {
+		int count = fill.flood(queries[k][0], queries[k][1]);
+		bits.expanded += count;
+		bits.found += count == reference[k];
+	}
+	bits.query_us = std::chrono::duration<double, std::micro>(
+			clock::now() - start).count();
+	bits.bytes = bench_alloc_bytes - bytes;
+	return {cells, bits};
+}
+
+/* path/cells has the cells of the A* paths, path/pull the corners string_pull()
+keeps of them */
+std::vector<bench_row_t> bench_any_angle(GameMap &map,
+		const std::vector<query_t> &queries)
+{
+	using clock = std::chrono::steady_clock;
+	auto costs = reference_costs(map, queries);
+	bench_row_t cells, pull;
+	cells.planner = "path/cells";
+	pull.planner = "path/pull";
+	cells.queries = pull.queries = queries.size();
+	cells.bound = 1;
+
+	grid_search_t search(map);
+	std::vector<Math::Point2i> path;
+	for (int k = 0; k < queries.size(); k++) {
+		auto &q = queries[k];
+		if (!search.search(q[0], q[1], q[2], q[3]) || costs[k] <= 0)
+			continue ;
+		path.clear();
+		search.get_path(path);
+		cells.found++;
+		cells.waypoints += path.size();
+		cells.add_ratio(double(search.cost()) / costs[k]);
+
+		Math::Point2i start(q[0], q[1]);
+		size_t bytes = bench_alloc_bytes;
+		auto begin = clock::now();
+		string_pull(map, start, path);
+		pull.query_us += std::chrono::duration<double, std::micro>(
+				clock::now() - begin).count();
+		pull.bytes += bench_alloc_bytes - bytes;
+		pull.found++;
+		pull.waypoints += path.size();
+		pull.add_ratio(double(path_length(start, path)) / costs[k]);
+	}
+	for (auto row : {&cells, &pull})
+		if (row->compared)
+			row->cost_ratio /= row->compared;
+	return {cells, pull};
+}
+
+std::vector<bench_row_t> bench_scenario(const char *scenario, GameMap &map,
+		int random_count)
+{
+	std::vector<bench_row_t> rows;
+	for (auto &&row : bench_fill(map, fixed_queries(map))) {
+		row.scenario = scenario;
+		row.set = "fixed";
+		rows.push_back(row);
+	}
+	for (auto &&row : bench_set(map, fixed_queries(map))) {
+		row.scenario = scenario;
+		row.set = "fixed";
+		rows.push_back(row);
+	}
+	for (auto &&row : bench_any_angle(map, fixed_queries(map))) {
+		row.scenario = scenario;
+		row.set = "fixed";
+		rows.push_back(row);
+	}
+	for (auto &&row : bench_set(map, random_queries(map, random_count))) {
+		row.scenario = scenario;
+		row.set = "random";
+		rows.push_back(row);
+	}
+	return rows;
+}
+
+void rows_to_csv(FILE *out, const std::vector<bench_row_t> &rows) {
+	fprintf(out, "scenario,set,planner,queries,found,expanded,peak_open,"
+			"bytes,build_us,query_us,ns_per_expansion,cost_ratio,"
+			"min_cost_ratio,max_cost_ratio,waypoints\n");
+	for (auto &&r : rows)
+		fprintf(out, "%s,%s,%s,%d,%d,%lld,%zu,%zu,%.1f,%.1f,%.1f,%.4f,%.4f,"
+				"%.4f,%lld\n",
+				r.scenario.c_str(), r.set.c_str(), r.planner.c_str(),
+				r.queries, r.found, r.expanded, r.peak_open, r.bytes,
+				r.build_us, r.query_us,
+				r.query_us * 1000 / std::max(r.expanded, 1LL),
+				r.cost_ratio, r.min_cost_ratio, r.max_cost_ratio,
+				r.waypoints);
+}
+
+/* prints the rows with costs out of their bounds, returns false if there
+are any */
+bool check_rows(const std::vector<bench_row_t> &rows) {
+	constexpr double EPS = 1e-9;
+	bool ok = true;
+	for (auto &&r : rows) {
+		if (!r.bound || !r.compared)
+			continue ;
+		if (r.min_cost_ratio < 1 - EPS || r.max_cost_ratio > r.bound + EPS) {
+			printf("FAIL %s %s %s: cost ratio %.4f..%.4f, bound 1..%.4f\n",
+					r.scenario.c_str(), r.set.c_str(), r.planner.c_str(),
+					r.min_cost_ratio, r.max_cost_ratio, r.bound);
+			ok = false;
+		}
+	}
+	return ok;
+}
+
+void print_rows(const std::vector<bench_row_t> &rows) {
+	printf("%-8s %-7s %-13s %6s %10s %9s %10s %10s %8s %9s\n", "scenario",
+			"set", "planner", "found", "expanded", "peak_open", "bytes",
+			"us/query", "cost", "waypoints");
+	for (auto &&r : rows)
+		printf("%-8s %-7s %-13s %6d %10lld %9zu %10zu %10.1f %8.4f %9lld\n",
+				r.scenario.c_str(), r.set.c_str(), r.planner.c_str(),
+				r.found, r.expanded, r.peak_open, r.bytes,
+				r.query_us / std::max(r.queries, 1), r.cost_ratio,
+				r.waypoints);
+}
+
+#endif
@@ -0,0 +1,279 @@
+#ifndef WORLD_FILE_H
+#define WORLD_FILE_H
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include "game_map.h"
+
+#if defined(_WIN32)
+	#include <windows.h>
+#else
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+#endif
+
+/* Packed binary world file.
+
+	header_t
+	index_t[count]		sorted by (row, col)
+	payloads			one per chunk, all of payload_size bytes
+
+A payload holds the CHK_SZ x CHK_SZ cells, then the layers flagged in the
+header: the walk bits of the chunk (CHK_SZ uint32_t) and the connectivity
+labels of the chunk (CHK_SZ x CHK_SZ int16_t, connectivity_t::label_chunk).
+Payloads are aligned to PAYLOAD_ALIGN bytes. All values are little endian.
+
+The file is opened with a single mmap, chunks are only paged in by the OS when
+they are first read, so opening doesn't depend on the size of the world.
+world_file_t::convert() writes the file from a map.json and it's chunk files. */
+
+struct world_file_t {
+	constexpr static uint32_t MAGIC = 0x444c5747;	// "GWLD"
+	constexpr static uint32_t VERSION = 1;
+	constexpr static uint32_t WALK_BITS = 1;
+	constexpr static uint32_t LABELS = 2;
+	constexpr static int PAYLOAD_ALIGN = 64;
+
+	struct header_t {
+		uint32_t magic;
+		uint32_t version;
+		uint32_t layers;
+		uint32_t count;
+		uint32_t payload_size;
+		uint32_t reserved;
+		uint64_t payload_offset;
+	};
+
+	struct index_t {
+		int32_t row;
+		int32_t col;
+	};
+
+	const uint8_t *data = NULL;
+	size_t size = 0;
+	const header_t *header = NULL;
+	const index_t *index = NULL;
+#if defined(_WIN32)
+	HANDLE file = INVALID_HANDLE_VALUE;
+	HANDLE mapping = NULL;
+#else
+	int fd = -1;
+#endif
+
+	world_file_t() {}
+
+	world_file_t(std::string path) {
+		open(path);
+	}
+
+	~world_file_t() {
+		close();
+	}
+
+	world_file_t(const world_file_t&) = delete;
+	world_file_t &operator = (const world_file_t&) = delete;
+
+	static uint32_t payload_size(uint32_t layers) {
+		size_t size = CHK_SZ * CHK_SZ;
+		if (layers & WALK_BITS)
+			size += CHK_SZ * sizeof(uint32_t);
+		if (layers & LABELS)
+			size += CHK_SZ * CHK_SZ * sizeof(int16_t);
+		return (size + PAYLOAD_ALIGN - 1) / PAYLOAD_ALIGN * PAYLOAD_ALIGN;
+	}
+
+	static uint64_t payload_offset(uint32_t count) {
+		uint64_t end = sizeof(header_t) + count * sizeof(index_t);
+		return (end + PAYLOAD_ALIGN - 1) / PAYLOAD_ALIGN * PAYLOAD_ALIGN;
+	}
+
+	/* true if the file starts with the world magic */
+	static bool is_world(std::string path) {
+		FILE *f = fopen(path.c_str(), "rb");
+		if (!f)
+			return false;
+		uint32_t magic = 0;
+		bool ok = fread(&magic, sizeof(magic), 1, f) == 1 && magic == MAGIC;
+		fclose(f);
+		return ok;
+	}
+
+	bool open(std::string path) {
+		close();
+#if defined(_WIN32)
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+				OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER fsize;
+		GetFileSizeEx(file, &fsize);
+		size = fsize.QuadPart;
+		mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+		if (mapping)
+			data = (const uint8_t *)MapViewOfFile(mapping, FILE_MAP_READ,
+					0, 0, 0);
+#else
+		fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0)
+			return false;
+		struct stat st;
+		if (fstat(fd, &st) == 0 && st.st_size > 0) {
+			size = st.st_size;
+			void *ptr = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+			data = ptr == MAP_FAILED ? NULL : (const uint8_t *)ptr;
+		}
+#endif
+		if (!data || !valid()) {
+			printf("not a world file: %s\n", path.c_str());
+			close();
+			return false;
+		}
+		header = (const header_t *)data;
+		index = (const index_t *)(data + sizeof(header_t));
+		return true;
+	}
+
+	bool valid() const {
+		if (size < sizeof(header_t))
+			return false;
+		auto h = (const header_t *)data;
+		return h->magic == MAGIC && h->version == VERSION &&
+				h->payload_size == payload_size(h->layers) &&
+				h->payload_offset == payload_offset(h->count) &&
+				h->payload_offset + uint64_t(h->count) * h->payload_size <= size;
+	}
+
+	void close() {
+#if defined(_WIN32)
+		if (data)
+			UnmapViewOfFile(data);
+		if (mapping)
+			CloseHandle(mapping);
+		if (file != INVALID_HANDLE_VALUE)
+			CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+		mapping = NULL;
+#else
+		if (data)
+			munmap((void *)data, size);
+		if (fd >= 0)
+			::close(fd);
+		fd = -1;
+#endif
+		data = NULL;
+		size = 0;
+		header = NULL;
+		index = NULL;
+	}
+
+	bool is_open() const {
+		return data != NULL;
+	}
+
+	int count() const {
+		return header ? header->count : 0;
+	}
+
+	GameMap::key_t key(int k) const {
+		return GameMap::key_t(index[k].row, index[k].col);
+	}
+
+	/* payload of the chunk, NULL if the world doesn't have it */
+	const uint8_t *find(int row, int col) const {
+		if (!header)
+			return NULL;
+		auto end = index + header->count;
+		auto it = std::lower_bound(index, end, index_t{row, col},
+				[](const index_t &a, const index_t &b) {
+					return a.row != b.row ? a.row < b.row : a.col < b.col;
+				});
+		if (it == end || it->row != row || it->col != col)
+			return NULL;
+		return data + header->payload_offset +
+				uint64_t(it - index) * header->payload_size;
+	}
+
+	const uint32_t *walk_bits(int row, int col) const {
+		auto payload = find(row, col);
+		if (!payload || !(header->layers & WALK_BITS))
+			return NULL;
+		return (const uint32_t *)(payload + CHK_SZ * CHK_SZ);
+	}
+
+	const int16_t *labels(int row, int col) const {
+		auto payload = find(row, col);
+		if (!payload || !(header->layers & LABELS))
+			return NULL;
+		size_t offset = CHK_SZ * CHK_SZ;
+		if (header->layers & WALK_BITS)
+			offset += CHK_SZ * sizeof(uint32_t);
+		return (const int16_t *)(payload + offset);
+	}
+
+	/* copies the chunk out of the file, false if the world doesn't have it */
+	bool load_chunk(int row, int col, GameMap::chunk_t &chunk) const {
+		auto payload = find(row, col);
+		if (!payload)
+			return false;
+		memcpy(chunk.m, payload, CHK_SZ * CHK_SZ);
+		if (auto walk = walk_bits(row, col))
+			memcpy(chunk.walk, walk, sizeof(chunk.walk));
+		else
+			chunk.update_walk();
+		return true;
+	}
+
+	void load_all(GameMap &map) const {
+		for (int k = 0; k < count(); k++)
+			load_chunk(index[k].row, index[k].col,
+					map.add_chunk(index[k].row, index[k].col));
+	}
+
+	/* Writes every chunk of map to path. label_fn(row, col, labels) fills the
+	CHK_SZ * CHK_SZ labels of a chunk, it's only called if layers has LABELS */
+	template <typename label_fn_t>
+	static bool write(GameMap &map, std::string path, uint32_t layers,
+			label_fn_t label_fn)
+	{
+		std::vector<index_t> keys;
+		for (auto &&chunk : map.data)
+			keys.push_back({chunk.first.x, chunk.first.y});
+		std::sort(keys.begin(), keys.end(), [](auto &a, auto &b) {
+			return a.row != b.row ? a.row < b.row : a.col < b.col;
+		});
+
+		header_t header = {MAGIC, VERSION, layers, uint32_t(keys.size()),
+				payload_size(layers), 0, payload_offset(keys.size())};
+		std::vector<uint8_t> out(header.payload_offset +
+				uint64_t(keys.size()) * header.payload_size);
+		memcpy(out.data(), &header, sizeof(header));
+		memcpy(out.data() + sizeof(header), keys.data(),
+				keys.size() * sizeof(index_t));
+		for (int k = 0; k < keys.size(); k++) {
+			auto &chunk = *map.find_chunk(keys[k].row, keys[k].col);
+			uint8_t *payload = out.data() + header.payload_offset +
+					uint64_t(k) * header.payload_size;
+			memcpy(payload, chunk.m, CHK_SZ * CHK_SZ);
+			payload += CHK_SZ * CHK_SZ;
+			if (layers & WALK_BITS) {
+				memcpy(payload, chunk.walk, sizeof(chunk.walk));
+				payload += sizeof(chunk.walk);
+			}
+			if (layers & LABELS)
+				label_fn(keys[k].row, keys[k].col, (int16_t *)payload);
+		}
+
+		FILE *f = fopen(path.c_str(), "wb");
+		if (!f)
+			return false;
+		bool ok = fwrite(out.data(), 1, out.size(), f) == out.size();
+		return fclose(f) == 0 && ok;
+	}
+};
+
+#endif
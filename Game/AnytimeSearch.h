@@ -0,0 +1,162 @@
+#ifndef ANYTIME_SEARCH_H
+#define ANYTIME_SEARCH_H
+
+#include <queue>
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "GameMap.h"
+
+/* Resumable A*, one per Destination.
+
+The open list and the g values are kept between calls, step() expands at most
+a budget of nodes and the next call continues from there. At any time the
+search knows the tile closest to the finish it has reached, pathFrom() gives
+the path to that tile, so a unit can start walking after the first step and
+take the better paths of the later steps as it goes.
+
+Units walk the tree of the search, so the tile a unit is on stays a node of it
+and pathFrom() goes from there: up the parents to the first tile that is on the
+path of the best node and then down that path. The search ends when it reaches
+the finish, runs out of nodes or has expanded limit nodes, done is set then. */
+
+class AnytimeSearch {
+public:
+	constexpr static int INF = 1000'000'000;
+	constexpr static int STRAIGHT = 10;
+	constexpr static int DIAGONAL = 14;
+
+	struct Node {
+		int g = INF;
+		int parent = -1;
+	};
+
+	std::unordered_map<int, Node> nodes;
+	std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>,
+			std::greater<std::pair<int, int>>> que;
+
+	Math::Point2i start;
+	Math::Point2i goal;
+	int width = 0;
+	int best = -1;
+	int bestH = INF;
+	int expanded = 0;
+	int limit = INF;
+	bool active = false;
+	bool done = false;
+
+	void reset() {
+		nodes.clear();
+		que = decltype(que)();
+		best = -1;
+		bestH = INF;
+		expanded = 0;
+		active = false;
+		done = false;
+	}
+
+	int toId (const Math::Point2i& pos) const {
+		return pos.x * width + pos.y;
+	}
+
+	Math::Point2i toPos (int id) const {
+		return Math::Point2i(id / width, id % width);
+	}
+
+	static int heuristic (const Math::Point2i& a, const Math::Point2i& b) {
+		int dx = abs(a.x - b.x);
+		int dy = abs(a.y - b.y);
+		return std::min(dx, dy) * DIAGONAL + abs(dx - dy) * STRAIGHT;
+	}
+
+	void init (const GameMap& map, const Math::Point2i& from,
+			const Math::Point2i& to, int maxExpand = INF)
+	{
+		reset();
+		width = map.width;
+		start = from;
+		goal = to;
+		limit = maxExpand;
+		int id = toId(start);
+		nodes[id].g = 0;
+		best = id;
+		bestH = heuristic(start, goal);
+		que.push({bestH, id});
+		active = true;
+	}
+
+	/* Expands at most budget nodes, returns true once the search is done.
+	Tiles are read from the map as they are reached, so the search sees the
+	map as it was when it got there */
+	bool step (const GameMap& map, int budget) {
+		while (!done && budget > 0) {
+			if (que.empty() || bestH == 0 || expanded >= limit) {
+				done = true;
+				break ;
+			}
+			auto [f, id] = que.top();
+			que.pop();
+			auto pos = toPos(id);
+			int g = nodes[id].g;
+			if (f > g + heuristic(pos, goal))
+				continue ;
+			budget--;
+			expanded++;
+
+			for (int i = -1; i <= 1; i++)
+				for (int j = -1; j <= 1; j++) {
+					auto neigh = pos + Math::Point2i(i, j);
+					if ((!i && !j) || !map.canAquire(neigh))
+						continue ;
+					int nid = toId(neigh);
+					int ng = g + (i && j ? DIAGONAL : STRAIGHT);
+					auto& n = nodes[nid];
+					if (ng >= n.g)
+						continue ;
+					n.g = ng;
+					n.parent = id;
+					int h = heuristic(neigh, goal);
+					if (h < bestH) {
+						bestH = h;
+						best = nid;
+					}
+					que.push({ng + h, nid});
+				}
+		}
+		return done;
+	}
+
+	/* true if the search reached the finish */
+	bool found() const {
+		return active && bestH == 0;
+	}
+
+	/* Path from the tile from to the best node, from excluded. Returns false
+	if from is not a node of the search */
+	bool pathFrom (const Math::Point2i& from,
+			std::vector<Math::Point2i>& path) const
+	{
+		path.clear();
+		int id = toId(from);
+		if (!active || !nodes.count(id) || nodes.at(id).g == INF)
+			return false;
+
+		std::unordered_set<int> onBest;
+		for (int k = best; k != -1; k = nodes.at(k).parent)
+			onBest.insert(k);
+		/* back up the tree to the path of the best node */
+		int join = id;
+		while (!onBest.count(join)) {
+			join = nodes.at(join).parent;
+			path.push_back(toPos(join));
+		}
+		size_t up = path.size();
+		for (int k = best; k != join; k = nodes.at(k).parent)
+			path.push_back(toPos(k));
+		std::reverse(path.begin() + up, path.end());
+		return true;
+	}
+};
+
+#endif
@@ -0,0 +1,328 @@
+#ifndef COOPERATIVE_H
+#define COOPERATIVE_H
+
+#include <queue>
+#include <memory>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
+
+#include "GameMap.h"
+#include "FlowField.h"
+#include "Unit.h"
+
+/* Windowed Hierarchical Cooperative A* (WHCA*) for units moving in groups.
+
+Units in cooperative mode plan in space and time. Every unit searches WINDOW
+ticks ahead, each step is a move to one of the 8 neighbours or a wait, and
+writes the (tile, tick) pairs of it's plan in the ReservationTable. The units
+that plan after it avoid those pairs and the moves that would swap two units,
+so collisions between planned units are solved before they happen instead of
+by taking tiles and searching again.
+
+The heuristic is the distance from the FlowField of the group, a reverse
+search from the target that is shared by the whole group and only grows as far
+as the units need (the hierarchical part), octile distance where it has nothing
+yet. Units replan every REPLAN ticks, staggered so only part of a group searches
+in the same tick, and the ones replanning in a tick take turns at going first.
+
+Only small groups plan like this from the start, big ones walk their flow
+field and a unit of theirs only plans here while it is stuck in a jam
+(Destination::congested), for one window, then it goes back to the field.
+
+Tiles taken by units that don't reserve (units outside any group) are walls for
+the search. If one of them steps on the next tile of a plan the unit waits and
+replans the next tick, no Destination::tries are spent. Units leave cooperative
+mode when they reach the target, or if the target can't be reached at all. */
+
+class ReservationTable {
+public:
+	std::unordered_map<int64_t, UnitId> cells;
+	std::unordered_map<uint64_t, std::vector<int64_t>> owned;
+	int64_t area;
+
+	ReservationTable (int64_t area = 1) : area(area) {}
+
+	int64_t key (int tile, int tick) const {
+		return int64_t(tick) * area + tile;
+	}
+
+	/* the unit holding the tile at tick, an invalid id if it's free */
+	UnitId holder (int tile, int tick) const {
+		auto it = cells.find(key(tile, tick));
+		return it == cells.end() ? UnitId() : it->second;
+	}
+
+	void reserve (int tile, int tick, const UnitId& unit) {
+		auto k = key(tile, tick);
+		cells[k] = unit;
+		owned[unit.key()].push_back(k);
+	}
+
+	void release (const UnitId& unit) {
+		auto it = owned.find(unit.key());
+		if (it == owned.end())
+			return ;
+		for (auto&& k : it->second) {
+			auto cell = cells.find(k);
+			if (cell != cells.end() && cell->second == unit)
+				cells.erase(cell);
+		}
+		owned.erase(it);
+	}
+};
+
+class CooperativePlanner {
+public:
+	const static int WINDOW = 16;
+	const static int REPLAN = WINDOW / 2;
+	const static int MAX_EXPAND = 2048;
+	const static int HEURISTIC_ITER = 512;
+	constexpr static int STRAIGHT = FlowField::STRAIGHT;
+	constexpr static int DIAGONAL = FlowField::DIAGONAL;
+
+	struct Node {
+		int g;
+		int h;
+		int64_t parent;
+	};
+
+	int tick = 0;
+	int width = 0;
+	ReservationTable table;
+	/* tiles held by cooperative units, those are solved by the table */
+	std::unordered_map<int, UnitId> held;
+	std::unordered_map<int64_t, Node> nodes;
+	std::priority_queue<std::pair<int, int64_t>,
+			std::vector<std::pair<int, int64_t>>,
+			std::greater<std::pair<int, int64_t>>> que;
+	int expanded = 0;
+
+	int toId (const Math::Point2i& pos) const {
+		return pos.x * width + pos.y;
+	}
+
+	static int octile (const Math::Point2i& a, const Math::Point2i& b) {
+		int di = abs(a.x - b.x);
+		int dj = abs(a.y - b.y);
+		return std::min(di, dj) * DIAGONAL + abs(di - dj) * STRAIGHT;
+	}
+
+	/* the field is only read here, plan() settles it for the whole window */
+	int heuristic (Destination& dest, const Math::Point2i& pos) {
+		auto& field = dest.flow;
+		int id = field->toId(pos);
+		if (field->closed(id))
+			return field->cost(id);
+		return octile(pos, dest.finish);
+	}
+
+	bool blocked (const GameMap& map, const UnitId& unit,
+			const Math::Point2i& from, const Math::Point2i& to, int t)
+	{
+		if (!map.inside(to))
+			return true;
+		int id = toId(to);
+		if (!map.canAquire(to) && !held.count(id))
+			return true;
+		auto other = table.holder(id, t);
+		if (other.valid() && !(other == unit))
+			return true;
+		/* two units can't trade places */
+		other = table.holder(id, t - 1);
+		return other.valid() && !(other == unit) &&
+				table.holder(toId(from), t) == other;
+	}
+
+	/* Space time A* from the tile of the unit at the current tick, WINDOW
+	ticks deep. The plan is written in dest.window and reserved. A tile of
+	the window is at most WINDOW moves away, so it's field cost is at most
+	WINDOW * DIAGONAL above the start's, the field is settled that far once
+	per plan and the heuristic of a node is kept from it's first push */
+	void plan (GameMap& map, UnitStore& units, int unit) {
+		auto id = units.ids[unit];
+		table.release(id);
+		auto& dest = units.dest[unit];
+		auto start = map.getTilePos(units.pos[unit]);
+		int64_t area = table.area;
+
+		nodes.clear();
+		que = decltype(que)();
+		expanded = 0;
+		auto& field = dest.flow;
+		if (field->settle(map, start, HEURISTIC_ITER) &&
+				field->reachable(start))
+		{
+			field->settleBelow(map, field->cost(field->toId(start)) +
+					WINDOW * DIAGONAL, HEURISTIC_ITER * WINDOW);
+		}
+		int64_t startKey = toId(start);
+		int startH = heuristic(dest, start);
+		nodes[startKey] = {0, startH, startKey};
+		que.push({startH, startKey});
+
+		int64_t best = startKey;
+		int bestH = que.top().first;
+		int bestDepth = 0;
+		while (!que.empty() && expanded < MAX_EXPAND) {
+			auto [f, key] = que.top();
+			que.pop();
+			int depth = key / area;
+			auto pos = Math::Point2i(key % area / width, key % area % width);
+			int g = nodes[key].g;
+			int h = nodes[key].h;
+			if (f > g + h)
+				continue ;
+			expanded++;
+			if (h < bestH || (h == bestH && depth > bestDepth)) {
+				best = key;
+				bestH = h;
+				bestDepth = depth;
+			}
+			if (pos == dest.finish || depth == WINDOW) {
+				best = key;
+				break ;
+			}
+			for (int k = 0; k < 9; k++) {
+				auto d = Math::Point2i(k / 3 - 1, k % 3 - 1);
+				auto next = pos + d;
+				if (blocked(map, id, pos, next, tick + depth + 1))
+					continue ;
+				int64_t nkey = (depth + 1) * area + toId(next);
+				int ng = g + (d.x && d.y ? DIAGONAL : STRAIGHT);
+				auto it = nodes.find(nkey);
+				if (it != nodes.end() && it->second.g <= ng)
+					continue ;
+				int nh = it != nodes.end() ? it->second.h :
+						heuristic(dest, next);
+				nodes[nkey] = {ng, nh, key};
+				que.push({ng + nh, nkey});
+			}
+		}
+
+		dest.window.clear();
+		for (int64_t key = best; ; key = nodes[key].parent) {
+			dest.window.push_back(Math::Point2i(key % area / width,
+					key % area % width));
+			if (key == startKey)
+				break ;
+		}
+		std::reverse(dest.window.begin(), dest.window.end());
+		dest.windowStart = tick;
+		for (int i = 0; i < dest.window.size(); i++)
+			table.reserve(toId(dest.window[i]), tick + i, id);
+	}
+
+	/* tile the unit should stand on at tick t */
+	Math::Point2i planned (const Destination& dest, int t) const {
+		int i = std::min(t - dest.windowStart, int(dest.window.size()) - 1);
+		return dest.window[std::max(i, 0)];
+	}
+
+	/* replans the units that are due and moves every cooperative unit one
+	tick along it's plan */
+	void step (GameMap& map, UnitStore& units) {
+		width = map.width;
+		if (table.area != int64_t(map.height) * width)
+			table = ReservationTable(int64_t(map.height) * width);
+
+		std::vector<int> active;
+		held.clear();
+		for (int i = 0; i < units.size(); i++) {
+			auto& dest = units.dest[i];
+			if (!dest.cooperative)
+				continue ;
+			auto tile = map.getTilePos(units.pos[i]);
+			if (tile == dest.finish) {
+				table.release(units.ids[i]);
+				dest.cooperative = false;
+				dest.window.clear();
+				continue ;
+			}
+			if (dest.congested && dest.window.size() &&
+					dest.replanAt <= tick)
+			{
+				/* back to the field, only a unit that moved starts counting
+				it's blocked ticks again */
+				if (!(tile == dest.window.front()))
+					dest.blocked = 0;
+				table.release(units.ids[i]);
+				dest.cooperative = false;
+				dest.congested = false;
+				dest.window.clear();
+				continue ;
+			}
+			held[toId(tile)] = units.ids[i];
+			active.push_back(i);
+		}
+
+		std::vector<int> due;
+		for (int k = 0; k < active.size(); k++) {
+			auto& dest = units.dest[active[k]];
+			if (dest.window.empty()) {
+				/* spread the first replans of a new group over REPLAN ticks,
+				a congested unit keeps it's one window for REPLAN ticks */
+				dest.replanAt = tick + (dest.congested ? REPLAN :
+						1 + k % REPLAN);
+				due.push_back(active[k]);
+			}
+			else if (dest.replanAt <= tick) {
+				dest.replanAt = tick + REPLAN;
+				due.push_back(active[k]);
+			}
+		}
+		if (due.size())
+			std::rotate(due.begin(), due.begin() + tick % due.size(), due.end());
+		for (auto&& unit : due) {
+			plan(map, units, unit);
+			auto& dest = units.dest[unit];
+			auto tile = map.getTilePos(units.pos[unit]);
+			auto& field = dest.flow;
+			if (dest.window.size() == 1 &&
+					field->settle(map, tile, HEURISTIC_ITER) &&
+					!field->reachable(tile))
+			{
+				/* no way to the target, let the unit plan on it's own */
+				table.release(units.ids[unit]);
+				dest.cooperative = false;
+				dest.congested = false;
+				dest.flow.reset();
+			}
+		}
+
+		/* units that free a tile go first, so the ones following them can
+		step in the same tick */
+		std::vector<int> pending;
+		for (auto&& unit : active)
+			if (units.dest[unit].cooperative)
+				pending.push_back(unit);
+		bool moved = true;
+		while (moved && pending.size()) {
+			moved = false;
+			for (int k = 0; k < pending.size(); k++) {
+				auto unit = pending[k];
+				auto tile = map.getTilePos(units.pos[unit]);
+				auto next = planned(units.dest[unit], tick + 1);
+				bool done = next == tile;
+				if (!done && map.canAquire(next)) {
+					map.release(tile);
+					units.dir[unit] = map.toWorld(next) - units.pos[unit];
+					units.pos[unit] = map.toWorld(next);
+					map.aquire(next);
+					done = true;
+				}
+				if (done) {
+					pending[k--] = pending.back();
+					pending.pop_back();
+					moved = true;
+				}
+			}
+		}
+		/* taken by a unit that doesn't reserve, wait and replan */
+		for (auto&& unit : pending)
+			units.dest[unit].replanAt = tick + 1;
+		tick++;
+	}
+};
+
+#endif
@@ -0,0 +1,271 @@
+#ifndef D_STAR_LITE_H
+#define D_STAR_LITE_H
+
+#include <queue>
+#include <vector>
+#include <unordered_map>
+
+#include "GameMap.h"
+
+/* D* Lite planner, one per Destination.
+
+The search runs backwards, from the finish to the unit, so when the unit moves
+or tiles change only the inconsistent part of the search is redone. The planner
+keeps it's own view of which tiles are blocked, a tile is read from the map the
+first time the search needs it. On each update the tiles in SENSE_RADIUS around
+the unit are compared with the map and only the ones that changed are repaired,
+changes far away are picked up once the unit gets close to them. This way units
+moving around in the distance don't make every planner redo it's search.
+
+Only the tiles touched by the search are stored. The search work per update is
+capped, if the cap is hit update() returns false and the next call continues
+from where this one stopped, pending is set while that happens. */
+
+class DStarLite {
+public:
+	constexpr static int INF = 1000'000'000;
+	constexpr static int STRAIGHT = 10;
+	constexpr static int DIAGONAL = 14;
+	constexpr static int SENSE_RADIUS = 3;
+
+	enum Tile : char {
+		UNKNOWN,
+		FREE,
+		BLOCKED,
+	};
+
+	struct Node {
+		int g = INF;
+		int rhs = INF;
+		Tile tile = UNKNOWN;
+	};
+
+	struct Key {
+		int k1;
+		int k2;
+		int id;
+
+		bool operator > (const Key& oth) const {
+			if (k1 != oth.k1)
+				return k1 > oth.k1;
+			return k2 > oth.k2;
+		}
+
+		bool operator < (const Key& oth) const {
+			if (k1 != oth.k1)
+				return k1 < oth.k1;
+			return k2 < oth.k2;
+		}
+	};
+
+	std::unordered_map<int, Node> nodes;
+	std::priority_queue<Key, std::vector<Key>, std::greater<Key>> que;
+
+	Math::Point2i start;
+	Math::Point2i last;
+	Math::Point2i goal;
+	int width = 0;
+	int km = 0;
+	bool active = false;
+	bool pending = false;
+
+	void reset() {
+		nodes.clear();
+		que = decltype(que)();
+		active = false;
+		pending = false;
+	}
+
+	int toId (const Math::Point2i& pos) const {
+		return pos.x * width + pos.y;
+	}
+
+	Math::Point2i toPos (int id) const {
+		return Math::Point2i(id / width, id % width);
+	}
+
+	static int heuristic (const Math::Point2i& a, const Math::Point2i& b) {
+		int dx = abs(a.x - b.x);
+		int dy = abs(a.y - b.y);
+		return std::min(dx, dy) * DIAGONAL + abs(dx - dy) * STRAIGHT;
+	}
+
+	const Node& get (int id) const {
+		static const Node none;
+		auto it = nodes.find(id);
+		return it == nodes.end() ? none : it->second;
+	}
+
+	Key calcKey (int id) const {
+		auto& n = get(id);
+		int m = std::min(n.g, n.rhs);
+		if (m == INF)
+			return Key{INF, INF, id};
+		return Key{m + heuristic(start, toPos(id)) + km, m, id};
+	}
+
+	bool blocked (const GameMap& map, int id) {
+		auto& n = nodes[id];
+		if (n.tile == UNKNOWN)
+			n.tile = map.canAquire(toPos(id)) ? FREE : BLOCKED;
+		return n.tile == BLOCKED;
+	}
+
+	bool blocked (const GameMap& map, int id) const {
+		auto& n = get(id);
+		if (n.tile == UNKNOWN)
+			return !map.canAquire(toPos(id));
+		return n.tile == BLOCKED;
+	}
+
+	static int stepCost (const Math::Point2i& a, const Math::Point2i& b) {
+		return (a.x != b.x && a.y != b.y) ? DIAGONAL : STRAIGHT;
+	}
+
+	template <typename Func>
+	void forNeighbours (const GameMap& map, const Math::Point2i& pos,
+			Func fn) const
+	{
+		for (int i = -1; i <= 1; i++)
+			for (int j = -1; j <= 1; j++) {
+				auto neigh = pos + Math::Point2i(i, j);
+				if ((i || j) && map.inside(neigh))
+					fn(neigh);
+			}
+	}
+
+	void updateVertex (const GameMap& map, int id) {
+		auto pos = toPos(id);
+		if (!(pos == goal)) {
+			int rhs = INF;
+			forNeighbours(map, pos, [&] (const Math::Point2i& neigh) {
+				int g = get(toId(neigh)).g;
+				if (g != INF && !blocked(map, toId(neigh)))
+					rhs = std::min(rhs, stepCost(pos, neigh) + g);
+			});
+			if (rhs == INF && nodes.find(id) == nodes.end())
+				return ;
+			nodes[id].rhs = rhs;
+		}
+		auto& n = nodes[id];
+		if (n.g != n.rhs)
+			que.push(calcKey(id));
+	}
+
+	bool computeShortestPath (const GameMap& map, int maxIter) {
+		int startId = toId(start);
+		while (!que.empty()) {
+			auto& s = get(startId);
+			if (!(que.top() < calcKey(startId)) && s.rhs == s.g)
+				return true;
+			if (maxIter <= 0)
+				return false;
+
+			Key old = que.top();
+			que.pop();
+			auto& n = nodes[old.id];
+			if (n.g == n.rhs)
+				continue ;
+			maxIter--;
+
+			Key now = calcKey(old.id);
+			if (old < now) {
+				que.push(now);
+			}
+			else if (n.g > n.rhs) {
+				n.g = n.rhs;
+				forNeighbours(map, toPos(old.id), [&] (const auto& neigh) {
+					updateVertex(map, toId(neigh));
+				});
+			}
+			else {
+				n.g = INF;
+				updateVertex(map, old.id);
+				forNeighbours(map, toPos(old.id), [&] (const auto& neigh) {
+					updateVertex(map, toId(neigh));
+				});
+			}
+		}
+		return true;
+	}
+
+	void init (const GameMap& map, const Math::Point2i& from,
+			const Math::Point2i& to)
+	{
+		reset();
+		width = map.width;
+		start = last = from;
+		goal = to;
+		km = 0;
+		nodes[toId(goal)].rhs = 0;
+		que.push(calcKey(toId(goal)));
+		active = true;
+	}
+
+	/* a tile changing only changes the cost of stepping into it, so only the
+	tiles around it need new rhs values */
+	void sense (const GameMap& map) {
+		for (int i = -SENSE_RADIUS; i <= SENSE_RADIUS; i++)
+			for (int j = -SENSE_RADIUS; j <= SENSE_RADIUS; j++) {
+				auto pos = start + Math::Point2i(i, j);
+				if (!map.inside(pos))
+					continue ;
+				auto it = nodes.find(toId(pos));
+				if (it == nodes.end() || it->second.tile == UNKNOWN)
+					continue ;
+				Tile now = map.canAquire(pos) ? FREE : BLOCKED;
+				if (it->second.tile == now)
+					continue ;
+				it->second.tile = now;
+				forNeighbours(map, pos, [&] (const auto& neigh) {
+					updateVertex(map, toId(neigh));
+				});
+			}
+	}
+
+	/* Brings the search up to date with the unit position and the tiles
+	around it, returns true if a path to the finish is known */
+	bool update (const GameMap& map, const Math::Point2i& from,
+			const Math::Point2i& to, int maxIter)
+	{
+		if (!active || !(to == goal) || width != map.width) {
+			init(map, from, to);
+		}
+		else {
+			start = from;
+			km += heuristic(last, start);
+			last = start;
+
+			sense(map);
+		}
+		pending = !computeShortestPath(map, maxIter);
+		return !pending && get(toId(start)).g != INF;
+	}
+
+	/* Walks the g values down from the start, at most maxLen tiles */
+	void getPath (const GameMap& map, std::vector<Math::Point2i>& path,
+			int maxLen) const
+	{
+		path.clear();
+		auto pos = start;
+		while (!(pos == goal) && maxLen-- > 0) {
+			int best = INF;
+			Math::Point2i next;
+			forNeighbours(map, pos, [&] (const Math::Point2i& neigh) {
+				int g = get(toId(neigh)).g;
+				if (g == INF || blocked(map, toId(neigh)))
+					return ;
+				if (stepCost(pos, neigh) + g < best) {
+					best = stepCost(pos, neigh) + g;
+					next = neigh;
+				}
+			});
+			if (best == INF)
+				break;
+			path.push_back(next);
+			pos = next;
+		}
+	}
+};
+
+#endif
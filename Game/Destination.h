@@ -1,42 +1,148 @@
 #ifndef DESTINATION_H
 #define DESTINATION_H
 
+#include "DStarLite.h"
+#include "AnytimeSearch.h"
+#include "FlowField.h"
+
 class Destination {
 public:
 	static const int MAX_TRIES = 20;
+	/* ticks a unit waits for a free tile of it's flow field before it
+	plans with the CooperativePlanner for a while, and before it plans on it's
+	own */
+	static const int CONGESTED = 3;
+	static const int MAX_BLOCKED = 10;
 	int next = 0;
 	std::vector<Math::Point2i> path;
+	/* a path shared with other units, walked from joinAt after path */
+	std::shared_ptr<const std::vector<Math::Point2i>> shared;
+	int joinAt = 0;
 	
 	Math::Point2i finish = Math::Point2i();
 	int tries = MAX_TRIES;
+	DStarLite planner;
+	AnytimeSearch search;
+	std::shared_ptr<FlowField> flow;
+	int blocked = 0;
+	int ticket = 0;
+	bool wantPath = false;
+	/* cooperative mode, the CooperativePlanner moves the unit along window,
+	the tiles to stand on from tick windowStart on */
+	bool cooperative = false;
+	/* cooperative only to get trough a jam, it goes back to the flow field
+	after one plan */
+	bool congested = false;
+	std::vector<Math::Point2i> window;
+	int windowStart = 0;
+	int replanAt = 0;
 
 	void clearPath() {
 		next = 0;
 		path.clear();
+		shared.reset();
+		joinAt = 0;
+	}
+
+	void setPath (std::vector<Math::Point2i> prefix,
+			std::shared_ptr<const std::vector<Math::Point2i>> route = nullptr,
+			int from = 0)
+	{
+		next = 0;
+		path = std::move(prefix);
+		shared = route;
+		joinAt = from;
+	}
+
+	int pathSize() const {
+		return path.size() + (shared ? shared->size() - joinAt : 0);
+	}
+
+	const Math::Point2i& pathAt (int i) const {
+		if (i < path.size())
+			return path[i];
+		return (*shared)[joinAt + i - path.size()];
 	}
 
 	void setFinish (Math::Point2i dest) {
 		clearPath();
 		finish = dest;
 		tries = MAX_TRIES;
+		planner.reset();
+		search.reset();
+		flow.reset();
+		blocked = 0;
+		ticket = 0;
+		wantPath = false;
+		cooperative = false;
+		congested = false;
+		window.clear();
+	}
+
+	/* same as setFinish, but the unit walks the shared field instead of
+	planning on it's own */
+	void setFlow (std::shared_ptr<FlowField> field) {
+		setFinish(field->target);
+		flow = field;
+	}
+
+	/* same as setFlow, the field is the heuristic of the cooperative search
+	of the group */
+	void setCooperative (std::shared_ptr<FlowField> field) {
+		setFlow(field);
+		cooperative = true;
+	}
+
+	/* Checks the finish against the components of the map before any search
+	is spent on it. A finish that can't be reached from the tile is moved to the
+	closest tile that can, the unit stays where it is if there is none near.
+	Returns false if the finish changed */
+	bool reachable (const GameMap& map, const Math::Point2i& from) {
+		if (map.connected(from, finish))
+			return true;
+		Math::Point2i to = from;
+		map.nearestConnected(from, finish, to);
+		clearPath();
+		finish = to;
+		planner.reset();
+		search.reset();
+		flow.reset();
+		blocked = 0;
+		ticket = 0;
+		return false;
+	}
+
+	/* repairs the planner search from the current tile and takes the new
+	path from it, returns false if the planner has no path (yet). A taken
+	finish tile can't be reached, so the planner isn't even asked */
+	bool replan (const GameMap& map, const Math::Point2i& from, int maxIter) {
+		if (!map.canAquire(finish)) {
+			planner.pending = false;
+			return false;
+		}
+		if (!planner.update(map, from, finish, maxIter))
+			return false;
+		clearPath();
+		planner.getPath(map, path, map.width * map.height);
+		return path.size() > 0;
 	}
 
 	Math::Point2i getNext() {
-		if (next < path.size()) {
-			return path[next];
+		if (next < pathSize()) {
+			return pathAt(next);
 		}
 		return Math::Point2i();
 	}
 
 	Math::Point2i advance() {
-		if (next < path.size()) {
-			return path[next++];
+		if (next < pathSize()) {
+			return pathAt(next++);
 		}
 		return Math::Point2i();
 	}
 
 	bool finishedPath() {
-		return next >= path.size();
+		return next >= pathSize();
 	}
 };
 
@@ -10,6 +10,8 @@ public:
 	float zNear;
 	float zFar;
 	float aspect;
+	/* how far the frame is between the last two simulation ticks */
+	float alpha = 1;
 
 	DrawContext(
 			const Math::Mat4f& proj = Math::identity<4, float>(),
@@ -0,0 +1,246 @@
+#ifndef FLOW_FIELD_H
+#define FLOW_FIELD_H
+
+#include <map>
+#include <cmath>
+#include <algorithm>
+#include <queue>
+#include <memory>
+#include <vector>
+
+#include "GameMap.h"
+
+/* Flow field towards one target tile, shared by all the units sent there.
+
+The integration field is a Dijkstra from the target that only runs as far as
+the units asking for directions need, so far away parts of the map are never
+touched. Costs and directions are stored in CHUNK x CHUNK blocks that are only
+allocated once the search reaches them. Directions are filled per tile the
+first time a unit asks for them.
+
+Walls are never given a cost. Tiles taken by units are expanded like free
+ones, the units of a group stand on the tiles the field has to cross, so they
+must not cut it. Which tiles are taken changes every tick, next() only steps
+on free ones. */
+
+class FlowField {
+public:
+	constexpr static int INF = 1000'000'000;
+	constexpr static int CHUNK = 16;
+	constexpr static int STRAIGHT = 10;
+	constexpr static int DIAGONAL = 14;
+	constexpr static int NO_DIR = 8;
+	constexpr static int UNKNOWN_DIR = -1;
+
+	struct Chunk {
+		int cost[CHUNK * CHUNK];
+		bool closed[CHUNK * CHUNK];
+		signed char dir[CHUNK * CHUNK];
+
+		Chunk() {
+			std::fill(cost, cost + CHUNK * CHUNK, INF);
+			std::fill(closed, closed + CHUNK * CHUNK, false);
+			std::fill(dir, dir + CHUNK * CHUNK, UNKNOWN_DIR);
+		}
+	};
+
+	Math::Point2i target;
+	int rows;
+	int cols;
+	int chunkRows;
+	int chunkCols;
+	std::vector<std::unique_ptr<Chunk>> chunks;
+	std::priority_queue<std::pair<int, int>, std::vector<std::pair<int, int>>,
+			std::greater<std::pair<int, int>>> que;
+	int expanded = 0;
+	/* cost of the farthest unit that stopped around the target */
+	int packed = 0;
+
+	FlowField (const GameMap& map, const Math::Point2i& target)
+	: target(target), rows(map.height), cols(map.width),
+	chunkRows((rows + CHUNK - 1) / CHUNK),
+	chunkCols((cols + CHUNK - 1) / CHUNK),
+	chunks(chunkRows * chunkCols)
+	{
+		if (map.inside(target)) {
+			int id = toId(target);
+			cost(id) = 0;
+			que.push({0, id});
+		}
+	}
+
+	/* the 8 neighbours, row by row, skipping the center */
+	static Math::Point2i dirOf (int k) {
+		int m = k + (k >= 4);
+		return Math::Point2i(m / 3 - 1, m % 3 - 1);
+	}
+
+	int toId (const Math::Point2i& pos) const {
+		return pos.x * cols + pos.y;
+	}
+
+	Math::Point2i toPos (int id) const {
+		return Math::Point2i(id / cols, id % cols);
+	}
+
+	Chunk& chunk (int id) {
+		int x = id / cols;
+		int y = id % cols;
+		auto& ptr = chunks[(x / CHUNK) * chunkCols + y / CHUNK];
+		if (!ptr)
+			ptr.reset(new Chunk());
+		return *ptr;
+	}
+
+	int local (int id) const {
+		return (id / cols % CHUNK) * CHUNK + id % cols % CHUNK;
+	}
+
+	int& cost (int id) {
+		return chunk(id).cost[local(id)];
+	}
+
+	bool& closed (int id) {
+		return chunk(id).closed[local(id)];
+	}
+
+	bool done() const {
+		return que.empty();
+	}
+
+	void expandOne (const GameMap& map) {
+		auto [c, id] = que.top();
+		que.pop();
+		if (closed(id))
+			return ;
+		closed(id) = true;
+		expanded++;
+
+		auto pos = toPos(id);
+		for (int k = 0; k < 8; k++) {
+			auto d = dirOf(k);
+			auto neigh = pos + d;
+			if (!map.inside(neigh) || map.isWall(neigh))
+				continue ;
+			int nid = toId(neigh);
+			int nc = c + (d.x && d.y ? DIAGONAL : STRAIGHT);
+			if (nc < cost(nid)) {
+				cost(nid) = nc;
+				que.push({nc, nid});
+			}
+		}
+	}
+
+	/* Runs the integration until the tile has it's final cost, at most
+	maxIter expansions. Returns false if the tile is still not settled */
+	bool settle (const GameMap& map, const Math::Point2i& tile, int maxIter) {
+		int id = toId(tile);
+		while (!closed(id) && !que.empty() && maxIter-- > 0)
+			expandOne(map);
+		return closed(id) || que.empty();
+	}
+
+	/* Runs the integration until all the tiles that cost at most limit have
+	their final cost, at most maxIter expansions. Returns false if some are
+	still not settled */
+	bool settleBelow (const GameMap& map, int limit, int maxIter) {
+		while (!que.empty() && que.top().first <= limit && maxIter-- > 0)
+			expandOne(map);
+		return que.empty() || que.top().first > limit;
+	}
+
+	bool reachable (const Math::Point2i& tile) {
+		return cost(toId(tile)) != INF;
+	}
+
+	/* Units packed around the target fill about a square of side
+	sqrt(units), a tile inside it is as close as one of them can get. Units
+	that stop there make the pile bigger, one that waited next to it stops
+	too instead of looking for a way trough it */
+	bool arrived (const Math::Point2i& tile, int units, bool waited) {
+		int radius = (int(std::sqrt(units)) + 1) / 2;
+		int c = cost(toId(tile));
+		if (c > DIAGONAL * radius && (!waited || c > packed + DIAGONAL))
+			return false;
+		packed = std::max(packed, c);
+		return true;
+	}
+
+	/* Direction field entry, the neighbour with the lowest cost */
+	int direction (const Math::Point2i& tile) {
+		int id = toId(tile);
+		auto& ch = chunk(id);
+		auto& dir = ch.dir[local(id)];
+		if (dir != UNKNOWN_DIR)
+			return dir;
+		dir = NO_DIR;
+		int best = cost(id);
+		for (int k = 0; k < 8; k++) {
+			auto neigh = tile + dirOf(k);
+			if (neigh.x < 0 || neigh.y < 0 || neigh.x >= rows || neigh.y >= cols)
+				continue ;
+			int nid = toId(neigh);
+			if (closed(nid) && cost(nid) < best) {
+				best = cost(nid);
+				dir = k;
+			}
+		}
+		return dir;
+	}
+
+	/* Next tile to walk to from tile. If the tile the field points to is
+	taken, any free neighbour that is closer to the target is used. Returns
+	false if there is no such tile right now */
+	bool next (const GameMap& map, const Math::Point2i& tile,
+			Math::Point2i& out)
+	{
+		int k = direction(tile);
+		if (k == NO_DIR)
+			return false;
+		out = tile + dirOf(k);
+		if (map.canAquire(out))
+			return true;
+
+		int best = cost(toId(tile));
+		bool found = false;
+		for (int k = 0; k < 8; k++) {
+			auto neigh = tile + dirOf(k);
+			if (!map.canAquire(neigh))
+				continue ;
+			int nid = toId(neigh);
+			if (closed(nid) && cost(nid) < best) {
+				best = cost(nid);
+				out = neigh;
+				found = true;
+			}
+		}
+		return found;
+	}
+};
+
+/* Keeps one field per target while at least one unit still uses it, fields
+are dropped as soon as the last Destination holding them lets go */
+class FlowFieldCache {
+public:
+	std::map<std::pair<int, int>, std::weak_ptr<FlowField>> fields;
+
+	std::shared_ptr<FlowField> get (const GameMap& map,
+			const Math::Point2i& target)
+	{
+		for (auto it = fields.begin(); it != fields.end(); ) {
+			if (it->second.expired())
+				it = fields.erase(it);
+			else
+				++it;
+		}
+		auto& entry = fields[{target.x, target.y}];
+		auto field = entry.lock();
+		if (!field) {
+			field = std::make_shared<FlowField>(map, target);
+			entry = field;
+		}
+		return field;
+	}
+};
+
+#endif
@@ -2,9 +2,9 @@
 #define GAME_H
 
 #include "Player.h"
-#include "GameMap.h"
-#include "Unit.h"
-#include "TankUnit.h"
+#include "Simulation.h"
+#include "MapRender.h"
+#include "UnitRender.h"
 #include "GameCamera.h"
 #include "GameUtil.h"
 
@@ -13,9 +13,9 @@ public:
 	constexpr const static float SELECT_THRESHOLD = 0.01;
 
 	Player player;
-	GameMap map;
-	std::vector<std::shared_ptr<Unit>> units;
-	std::vector<std::shared_ptr<Unit>> selectedUnits;
+	Simulation sim;
+	std::vector<UnitId> selectedUnits;
+	MapRender mapRender;
 	ShaderProgram unitShader;
 	GameCamera camera;
 
@@ -26,35 +26,19 @@ public:
 	bool wasRmb = false;
 	bool wallAdd = false;
 
-	Game (int mapWidth, int mapHeight) : map(mapWidth, mapHeight) {
-		spawnUnit(1, 1, 3, 3);
-		spawnUnit(1, 1, 3, 4);
-		spawnUnit(1, 1, 3, 5);
-		spawnUnit(1, 1, 6, 3);
-		spawnUnit(1, 1, 7, 3);
+	Game (int mapWidth, int mapHeight) : sim(mapWidth, mapHeight) {
+		sim.spawnUnit(1, 1, 3, 3);
+		sim.spawnUnit(1, 1, 3, 4);
+		sim.spawnUnit(1, 1, 3, 5);
+		sim.spawnUnit(1, 1, 6, 3);
+		sim.spawnUnit(1, 1, 7, 3);
 		camera -= World::up * 100;
 		camera.horizRot += 120;
 		camera.speed = Camera::DEFAULT_MOV_SPEED * 5;
 	}
 
-	void spawnUnit (int player, int type, int i, int j) {
-		if (map.canAquire(i, j)) {
-			map.aquire(i, j);
-			units.push_back(std::shared_ptr<Unit>(new TankUnit(player, type)));
-			units.back()->pos = Math::Point3f(i, 0, j) * map.scale;
-			units.back()->dest.setFinish(Math::Point2i(i, j));
-		}
-	}
-
 	void update() {
-		static int timeout = 0;
-		timeout++;
-		if (timeout > 2) {
-			timeout = 0;
-			for (auto&& unit : units) {
-				unit->move(map);
-			}
-		}
+		sim.update();
 	}
 
 	auto mouseToMap(Math::Point2f pos, DrawContext& drawContext) {
@@ -120,15 +104,16 @@ public:
 	void onMakeSelection (Math::Point2f a, Math::Point2f b,
 			DrawContext& drawContext)
 	{
+		auto& units = sim.units;
 		selectedUnits.clear();
-		for (auto&& unit : units) {
+		for (int i = 0; i < units.size(); i++) {
 			Math::Point2f result = Util::toScreen(
-				unit->pos,
+				units.pos[i],
 				drawContext.proj,
 				drawContext.view
 			);
 			if (Util::inSquare(result, a, b))
-				selectedUnits.push_back(unit);
+				selectedUnits.push_back(units.ids[i]);
 		}
 	}
 
@@ -139,23 +124,21 @@ public:
 		auto [was_intersect, map_pos] = mouseToMap(pos, drawContext);
 		if (was_intersect) {
 			selection = map_pos;
-			auto tilePos = map.getTilePos(Point2f(selection.x, selection.z));
+			auto tilePos = sim.map.getTilePos(Point2f(selection.x,
+					selection.z));
 			if (wallAdd) {
-				spawnUnit(1, 1,
+				sim.spawnUnit(1, 1,
 					tilePos.x,
 					tilePos.y
 				);
 			}
-			else {
-				for (auto&& unit : selectedUnits) {
-					unit->dest.setFinish(tilePos);
-				}
-			}
+			else
+				sim.order(selectedUnits, tilePos);
 		}
 	}
 
 	void initRender() {
-		map.initRender();
+		mapRender.init(sim.map);
 		unitShader = ShaderProgram({
 			{GL_VERTEX_SHADER, "Shaders/mapShader.vert"},
 			{GL_FRAGMENT_SHADER, "Shaders/mapShader.frag"}
@@ -167,25 +150,31 @@ public:
 	} 
 
 	void render (DrawContext& drawContext) {
+		double start = SimClock::now();
 		DrawContext newContext = drawContext;
 		newContext.view = camera.getTransform();
-		map.render(newContext);
-		for (auto&& unitPtr : units) {
-			unitPtr->render(newContext, unitShader);
-		}
+		newContext.alpha = sim.clock.alpha();
+		mapRender.render(newContext);
+		UnitRender::render(newContext, unitShader, sim.units);
 		unitShader.useProgram();
 		unitShader.setMatrix("projectionMatrix", newContext.proj);
 		unitShader.setMatrix("viewMatrix", newContext.view);
 		unitShader.setMatrix("worldMatrix", newContext.world);
-		for (auto&& selectUnit : selectedUnits) {
-			Util::drawLine(selectUnit->pos, selectUnit->pos + World::up * 10);
-			// for (auto&& pos : selectUnit->dest.path) {
-			// 	Util::drawLine(map.toWorld(pos), map.toWorld(pos) + World::up * 7,
+		for (auto&& id : selectedUnits) {
+			int unit = sim.units.index(id);
+			if (unit < 0)
+				continue ;
+			auto pos = sim.units.renderPos(unit, newContext.alpha);
+			Util::drawLine(pos, pos + World::up * 10);
+			// for (auto&& pos : sim.units.dest[unit].path) {
+			// 	Util::drawLine(sim.map.toWorld(pos),
+			// 			sim.map.toWorld(pos) + World::up * 7,
 			// 			Math::Point4f(1, 0, 0, 1));
 			// }
 		}
 		Util::drawLine(selection, selection + World::up * 10);
 		Util::drawLine(mouse_pos_map, mouse_pos_map + World::up * 15);
+		SimClock::average(sim.clock.renderMs, (SimClock::now() - start) * 1000);
 	}
 
 	void render2D(DrawContext& drawContext) {
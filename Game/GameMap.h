@@ -1,58 +1,85 @@
 #ifndef GAME_MAP_H
 #define GAME_MAP_H
 
+#include <atomic>
+#include <vector>
+#include <cstdlib>
+
+#include "MathLib.h"
 #include "MapTile.h"
 
 class GameMap {
 public:
-	using MapVertexType = Vertex<
-		Math::Point3f,	VertexPosition,
-		Math::Point3f,	VertexNormal,
-		Math::Point4f,	VertexColor,
-		Math::Point2f,	VertexTexCoord
-	>;
+	/* tiles are grouped in REGION x REGION squares, each with a version that
+	changes every time a wall is built or removed in it, units taking and
+	leaving tiles don't change it. Tile (x, y) is tiles[x * width + y], x goes
+	up to height */
+	const static int REGION = 16;
+
+	/* Connected components of the tiles that are not walls, with the 8
+	neighbour moves of the searches. labels is the component of each tile,
+	NONE for walls, and parents a union-find over them. Removing a wall joins
+	the components around it at once. Adding one can split a component, the
+	wall is kept and updateComponents() searches from one tile of each group of
+	free neighbours of the walls added, all the searches at once, one tile per
+	search in turn. Searches that meet are joined, a search that runs out of
+	tiles first is a piece that was cut off and only it's tiles get a new label.
+	The searches of a component stop when only one of them is left, so the work
+	is about the size of the pieces cut off, not of the map. A batch of more
+	than one wall in FLOOD_WALLS tiles, like the walls of a new map, floods the
+	whole map once instead. Till then two tiles can look connected when they
+	are not, never the other way. Units don't change them */
+	constexpr static int NONE = -1;
+	constexpr static int MAX_REDIRECT = 64;
+	constexpr static int FLOOD_WALLS = 64;
 
 	int width;
 	int height;
 	float scale;
-	std::vector<std::vector<MapTile>> tiles;
-
-	Mesh<MapVertexType> mMap;
-	DeprecatedVBOMeshDraw gMap;
-	ShaderProgram shader;
+	std::vector<MapTile> tiles;
+	int regionCols;
+	std::vector<std::atomic<int>> versions;
+	std::vector<char> walls;
+	std::vector<int> labels;
+	std::vector<int> parents;
+	std::vector<int> added;
+	/* the search of updateComponents() that reached each tile, if it's stamp
+	is the one of the update */
+	std::vector<int> owners;
+	std::vector<uint32_t> stamps;
+	uint32_t stamp = 0;
 
 	GameMap (int width, int height, float scale = 50)
 	: width(width), height(height), scale(scale),
-	tiles(height, std::vector<MapTile>(width)) {
+	tiles(width * height),
+	regionCols((width + REGION - 1) / REGION),
+	versions(regionCols * ((height + REGION - 1) / REGION)),
+	walls(width * height), labels(width * height, 0), parents(1, 0) {
 		aquire(0, 0);
 	}
 
+	int toId (int x, int y) const {
+		return x * width + y;
+	}
+
 	auto& operator () (int x, int y) {
-		return tiles[x][y];
+		return tiles[toId(x, y)];
 	}
 
 	const auto& operator () (int x, int y) const {
-		return tiles[x][y];
+		return tiles[toId(x, y)];
 	}
 
 	auto& operator () (const Math::Point2i& pos) {
-		return tiles[pos.x][pos.y];
+		return tiles[toId(pos.x, pos.y)];
 	}
 
 	const auto& operator () (const Math::Point2i& pos) const {
-		return tiles[pos.x][pos.y];
-	}
-
-	auto& operator [] (int i) {
-		return tiles[i];
-	}
-
-	const auto& operator [] (int i) const {
-		return tiles[i];
+		return tiles[toId(pos.x, pos.y)];
 	}
 
 	bool inside (int x, int y) const {
-		return x >= 0 && y >= 0 && x < tiles.size() && y < tiles[0].size();
+		return x >= 0 && y >= 0 && x < height && y < width;
 	}
 
 	bool inside (const Math::Point2i& pos) const {
@@ -75,6 +102,10 @@ public:
 		return Math::Point3f(pos.x * scale, 0, pos.y * scale);
 	}
 
+	int getRegion (const Math::Point2i& pos) const {
+		return (pos.x / REGION) * regionCols + pos.y / REGION;
+	}
+
 	auto& operator () (const Math::Point2f& pos) {
 		return (*this)(getTilePos(pos));
 	}
@@ -83,43 +114,284 @@ public:
 		return (*this)(getTilePos(pos));
 	}
 
-	void initRender() {
-		using namespace Math;
-		shader = ShaderProgram({
-			{GL_VERTEX_SHADER, "Shaders/mapShader.vert"},
-			{GL_FRAGMENT_SHADER, "Shaders/mapShader.frag"}
-		});
-		for (int i = 0; i < height; i++)
-			for (int j = 0; j < width; j++)
-				Util::addSquareW(mMap, 1.5,
-						Vec4f((i + j) % 2, 0, 1, 1),
-						translation<float>(i, 0, j) *
-						rot4<float>(-90, World::west) *
-						scale);
-
-		gMap = DeprecatedVBOMeshDraw(mMap);
-	}
-
-	void render (DrawContext& drawContext) {
-		shader.useProgram();
-		shader.setMatrix("projectionMatrix", drawContext.proj);
-		shader.setMatrix("viewMatrix", drawContext.view);
-		shader.setMatrix("worldMatrix", drawContext.world);
-		gMap.draw(shader);
+	/* a tile taken by setWall, not by a unit */
+	bool isWall (const Math::Point2i& pos) const {
+		return walls[toId(pos.x, pos.y)];
 	}
 
+	/* returns false if the tile is outside or already taken */
 	bool aquire (int x, int y) {
-		return inside(x, y) && tiles[x][y].aquire();
+		return inside(x, y) && tiles[toId(x, y)].aquire();
 	}
 
 	bool canAquire (int x, int y) const {
-		return inside(x, y) && tiles[x][y].canAquire();
+		return inside(x, y) && tiles[toId(x, y)].canAquire();
 	}
 
 	void release(int x, int y) {
-		if (inside(x, y)) {
-			tiles[x][y].release();
+		if (inside(x, y))
+			tiles[toId(x, y)].release();
+	}
+
+	/* Edits the map, a wall is a tile that stays taken. Returns false if
+	the tile is outside or nothing changed, else the version of it's region
+	changes */
+	bool setWall (int x, int y, bool wall) {
+		if (!inside(x, y))
+			return false;
+		int id = toId(x, y);
+		auto& tile = tiles[id];
+		if (!(wall ? tile.aquire() : tile.release()))
+			return false;
+		versions[getRegion(Math::Point2i(x, y))]++;
+		walls[id] = wall;
+		if (wall) {
+			labels[id] = NONE;
+			added.push_back(id);
+			return true;
+		}
+		int label = parents.size();
+		parents.push_back(label);
+		labels[id] = label;
+		for (int i = -1; i <= 1; i++)
+			for (int j = -1; j <= 1; j++) {
+				int other = component(Math::Point2i(x + i, y + j));
+				if (other != NONE && other != label) {
+					parents[std::max(other, label)] = std::min(other, label);
+					label = std::min(other, label);
+				}
+			}
+		return true;
+	}
+
+	/* the 8 neighbours in order around the tile */
+	static Math::Point2i ring (int k) {
+		const static int di[] = {-1, -1, -1, 0, 1, 1, 1, 0};
+		const static int dj[] = {-1, 0, 1, 1, 1, 0, -1, -1};
+		return Math::Point2i(di[k], dj[k]);
+	}
+
+	/* Groups the free neighbours of the tile at (x, y) by the ones that
+	touch, group[k] is the first neighbour of the group of neighbour k, NONE
+	for walls. Returns the number of groups */
+	int ringGroups (int x, int y, int group[8]) const {
+		for (int k = 0; k < 8; k++) {
+			auto pos = Math::Point2i(x, y) + ring(k);
+			group[k] = component(pos) == NONE ? NONE : k;
+		}
+		/* neighbours of the ring that touch take the lowest group */
+		for (bool changed = true; changed; ) {
+			changed = false;
+			for (int a = 0; a < 8; a++)
+				for (int b = 0; b < 8; b++) {
+					auto da = ring(a);
+					auto db = ring(b);
+					if (group[a] == NONE || group[b] <= group[a] ||
+							abs(da.x - db.x) > 1 || abs(da.y - db.y) > 1)
+						continue ;
+					group[b] = group[a];
+					changed = true;
+				}
+		}
+		int count = 0;
+		for (int k = 0; k < 8; k++)
+			count += group[k] == k;
+		return count;
+	}
+
+	/* Searches from the walls added since the last call, see the top of the
+	class, must not run while other threads read the components. A piece cut
+	off a component touches one of those walls, the tiles next to it are in the
+	piece, so one of the searches starts in every piece */
+	void updateComponents() {
+		if (added.empty())
+			return ;
+		if (added.size() * FLOOD_WALLS > tiles.size()) {
+			added.clear();
+			flood();
+			return ;
+		}
+		if (stamps.size() != tiles.size()) {
+			owners.assign(tiles.size(), 0);
+			stamps.assign(tiles.size(), 0);
+		}
+		stamp++;
+
+		struct Search {
+			int comp;
+			int head;
+			std::vector<int> queue;
+		};
+		std::vector<Search> searches;
+		/* union-find of the searches that met, the tiles left in the queues
+		and the searches of each root */
+		std::vector<int> joined;
+		std::vector<int> pending;
+		std::vector<std::vector<int>> members;
+		/* searches of each component that are neither joined nor done */
+		std::vector<int> open(parents.size());
+		auto root = [&] (int s) {
+			while (joined[s] != s)
+				s = joined[s];
+			return s;
+		};
+		auto reach = [&] (int s, int id) {
+			stamps[id] = stamp;
+			owners[id] = s;
+			searches[s].queue.push_back(id);
+			pending[root(s)]++;
+		};
+		for (auto&& wall : added) {
+			int group[8];
+			int x = wall / width;
+			int y = wall % width;
+			if (!walls[wall] || !ringGroups(x, y, group))
+				continue ;
+			for (int k = 0; k < 8; k++) {
+				auto pos = Math::Point2i(x, y) + ring(k);
+				int seed = toId(pos.x, pos.y);
+				if (group[k] != k || stamps[seed] == stamp)
+					continue ;
+				int s = searches.size();
+				searches.push_back({component(pos), 0, {}});
+				joined.push_back(s);
+				pending.push_back(0);
+				members.push_back({s});
+				open[searches[s].comp]++;
+				reach(s, seed);
+			}
+		}
+		added.clear();
+
+		std::vector<int> active(searches.size());
+		for (int s = 0; s < searches.size(); s++)
+			active[s] = s;
+		while (active.size()) {
+			int kept = 0;
+			for (auto&& s : active) {
+				auto& cur = searches[s];
+				if (cur.head == cur.queue.size() || open[cur.comp] <= 1)
+					continue ;
+				active[kept++] = s;
+				int id = cur.queue[cur.head++];
+				pending[root(s)]--;
+				for (int k = 0; k < 8; k++) {
+					auto pos = Math::Point2i(id / width, id % width) + ring(k);
+					if (component(pos) != cur.comp)
+						continue ;
+					int next = toId(pos.x, pos.y);
+					if (stamps[next] != stamp) {
+						reach(s, next);
+						continue ;
+					}
+					int a = root(s);
+					int b = root(owners[next]);
+					if (a == b)
+						continue ;
+					if (members[a].size() < members[b].size())
+						std::swap(a, b);
+					joined[b] = a;
+					pending[a] += pending[b];
+					members[a].insert(members[a].end(), members[b].begin(),
+							members[b].end());
+					members[b].clear();
+					open[cur.comp]--;
+				}
+				int r = root(s);
+				if (pending[r])
+					continue ;
+				/* cut off, the rest keeps the old label */
+				int label = parents.size();
+				parents.push_back(label);
+				for (auto&& m : members[r])
+					for (auto&& tile : searches[m].queue)
+						labels[tile] = label;
+				open[cur.comp]--;
+			}
+			active.resize(kept);
+		}
+	}
+
+	/* labels all the components again */
+	void flood() {
+		std::fill(labels.begin(), labels.end(), NONE);
+		parents.clear();
+		std::vector<int> stack;
+		for (int id = 0; id < tiles.size(); id++) {
+			if (walls[id] || labels[id] != NONE)
+				continue ;
+			int label = parents.size();
+			parents.push_back(label);
+			labels[id] = label;
+			stack.push_back(id);
+			while (stack.size()) {
+				int cur = stack.back();
+				stack.pop_back();
+				for (int k = 0; k < 8; k++) {
+					auto pos = Math::Point2i(cur / width, cur % width) +
+							ring(k);
+					if (!inside(pos))
+						continue ;
+					int next = toId(pos.x, pos.y);
+					if (walls[next] || labels[next] != NONE)
+						continue ;
+					labels[next] = label;
+					stack.push_back(next);
+				}
+			}
+		}
+	}
+
+	/* component of the tile, NONE for walls and tiles outside */
+	int component (const Math::Point2i& pos) const {
+		if (!inside(pos))
+			return NONE;
+		int label = labels[toId(pos.x, pos.y)];
+		while (label != NONE && parents[label] != label)
+			label = parents[label];
+		return label;
+	}
+
+	bool connected (const Math::Point2i& a, const Math::Point2i& b) const {
+		int comp = component(a);
+		return comp != NONE && comp == component(b);
+	}
+
+	/* The tile connected to from that is closest to to in octile distance,
+	looked up in growing squares around to, at most MAX_REDIRECT away. A tile
+	on square r is at least 10 * r away, so the squares after the first hit
+	are still looked at while that can beat it. Returns false if there is
+	none */
+	bool nearestConnected (const Math::Point2i& from, const Math::Point2i& to,
+			Math::Point2i& out) const
+	{
+		int comp = component(from);
+		if (comp == NONE)
+			return false;
+		if (component(to) == comp) {
+			out = to;
+			return true;
+		}
+		int best = -1;
+		for (int r = 1; r <= MAX_REDIRECT && (best < 0 || 10 * r < best);
+				r++)
+		{
+			for (int i = to.x - r; i <= to.x + r; i++)
+				for (int j = to.y - r; j <= to.y + r;
+						j += (i == to.x - r || i == to.x + r) ? 1 : 2 * r)
+				{
+					if (component(Math::Point2i(i, j)) != comp)
+						continue ;
+					int di = abs(i - to.x);
+					int dj = abs(j - to.y);
+					int d = std::min(di, dj) * 14 + abs(di - dj) * 10;
+					if (best < 0 || d < best) {
+						best = d;
+						out = Math::Point2i(i, j);
+					}
+				}
 		}
+		return best >= 0;
 	}
 
 	bool aquire (const Math::Point2i& pos) {
@@ -0,0 +1,49 @@
+#ifndef MAP_RENDER_H
+#define MAP_RENDER_H
+
+#include "ShaderProgram.h"
+#include "GameMap.h"
+
+/* The tiles of a GameMap drawn as one mesh. The map keeps no render state, so
+the simulation can run without a GL context */
+
+class MapRender {
+public:
+	using MapVertexType = Vertex<
+		Math::Point3f,	VertexPosition,
+		Math::Point3f,	VertexNormal,
+		Math::Point4f,	VertexColor,
+		Math::Point2f,	VertexTexCoord
+	>;
+
+	Mesh<MapVertexType> mMap;
+	DeprecatedVBOMeshDraw gMap;
+	ShaderProgram shader;
+
+	void init (const GameMap& map) {
+		using namespace Math;
+		shader = ShaderProgram({
+			{GL_VERTEX_SHADER, "Shaders/mapShader.vert"},
+			{GL_FRAGMENT_SHADER, "Shaders/mapShader.frag"}
+		});
+		for (int i = 0; i < map.height; i++)
+			for (int j = 0; j < map.width; j++)
+				Util::addSquareW(mMap, 1.5,
+						Vec4f((i + j) % 2, 0, 1, 1),
+						translation<float>(i, 0, j) *
+						rot4<float>(-90, World::west) *
+						map.scale);
+
+		gMap = DeprecatedVBOMeshDraw(mMap);
+	}
+
+	void render (DrawContext& drawContext) {
+		shader.useProgram();
+		shader.setMatrix("projectionMatrix", drawContext.proj);
+		shader.setMatrix("viewMatrix", drawContext.view);
+		shader.setMatrix("worldMatrix", drawContext.world);
+		gMap.draw(shader);
+	}
+};
+
+#endif
\ No newline at end of file
@@ -1,21 +1,29 @@
 #ifndef MAP_TILE_H
 #define MAP_TILE_H
 
+#include <atomic>
+
+/* A tile is taken and released with compare and swap, so units moving on
+different threads can't both take it */
+
 class MapTile {
 public:
-	bool empty = true;
+	std::atomic<bool> empty = true;
 
+	/* returns false if the tile was already taken */
 	bool aquire() {
-		empty = false;
-		return empty;
+		bool was = true;
+		return empty.compare_exchange_strong(was, false);
 	}
 
 	bool canAquire() const {
-		return empty;
+		return empty.load(std::memory_order_relaxed);
 	}
 
-	void release() {
-		empty = true;
+	/* returns false if the tile was already free */
+	bool release() {
+		bool was = false;
+		return empty.compare_exchange_strong(was, true);
 	}
 };
 
@@ -0,0 +1,189 @@
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#include <map>
+#include <tuple>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "GameMap.h"
+#include "Unit.h"
+
+/* Paths found by the PathService, kept for other units going to the same
+place.
+
+Entries are keyed by the region the search started in, the finish tile and
+the unit type. A unit asking for a path that is in the cache walks in a
+straight line to the closest waypoint and shares the rest of the path with
+everyone else that uses it. If the search for a key is still running the unit
+waits for it instead of starting it's own. Every entry remembers the versions
+of the map regions it's path crosses and is dropped once a wall was built or
+removed in one of them. Units standing on the path don't drop it, the steps to
+the waypoint are checked when a unit joins and the rest is walked like any
+other path. Only paths that reach the finish are kept, a search that ran out of
+iterations ends at the closest tile it found, which is only good for the unit
+that asked for it. */
+
+class PathCache {
+public:
+	const static int MAX_ENTRIES = 64;
+	const static int MAX_JOIN = GameMap::REGION * 2;
+
+	using Path = std::vector<Math::Point2i>;
+	using Key = std::tuple<int, int, int, int>;
+
+	struct Entry {
+		int ticket = 0;
+		std::shared_ptr<const Path> path;
+		std::vector<int> regions;
+		std::vector<int> versions;
+		std::vector<UnitId> followers;
+	};
+
+	std::map<Key, Entry> entries;
+	std::unordered_map<int, Key> pending;
+	int hits = 0;
+	int misses = 0;
+
+	static Key toKey (const GameMap& map, const UnitStore& units, int unit,
+			const Math::Point2i& from)
+	{
+		auto& finish = units.dest[unit].finish;
+		return Key{map.getRegion(from), finish.x, finish.y, units.type[unit]};
+	}
+
+	static int distance (const Math::Point2i& a, const Math::Point2i& b) {
+		return std::max(abs(a.x - b.x), abs(a.y - b.y));
+	}
+
+	bool valid (const GameMap& map, const Entry& entry) const {
+		for (int i = 0; i < entry.regions.size(); i++)
+			if (map.versions[entry.regions[i]] != entry.versions[i])
+				return false;
+		return true;
+	}
+
+	/* Walks from the tile to the closest waypoint, the steps on the way
+	must be free now. Gives the unit the rest of the shared path */
+	bool connect (const GameMap& map, Destination& dest,
+			const Math::Point2i& from, const std::shared_ptr<const Path>& path)
+	{
+		int best = -1;
+		for (int i = 0; i < path->size(); i++)
+			if (best < 0 || distance(from, (*path)[i]) <=
+					distance(from, (*path)[best]))
+				best = i;
+		if (best < 0 || distance(from, (*path)[best]) > MAX_JOIN)
+			return false;
+
+		auto to = (*path)[best];
+		if (from == to) {
+			dest.setPath({}, path, best + 1);
+			return true;
+		}
+		Path prefix;
+		auto pos = from;
+		while (true) {
+			pos = pos + Math::Point2i((to.x > pos.x) - (to.x < pos.x),
+					(to.y > pos.y) - (to.y < pos.y));
+			if (pos == to)
+				break;
+			if (!map.canAquire(pos))
+				return false;
+			prefix.push_back(pos);
+		}
+		dest.setPath(std::move(prefix), path, best);
+		return true;
+	}
+
+	/* Returns true if the unit got a path from the cache or waits for one
+	that is being searched, false if it has to search itself */
+	bool join (const GameMap& map, UnitStore& units, int unit,
+			const Math::Point2i& from)
+	{
+		auto it = entries.find(toKey(map, units, unit, from));
+		if (it == entries.end())
+			return false;
+		auto& entry = it->second;
+		if (entry.ticket) {
+			units.dest[unit].ticket = entry.ticket;
+			entry.followers.push_back(units.ids[unit]);
+			hits++;
+			return true;
+		}
+		if (!valid(map, entry)) {
+			entries.erase(it);
+			return false;
+		}
+		if (!connect(map, units.dest[unit], from, entry.path))
+			return false;
+		hits++;
+		return true;
+	}
+
+	/* The search with this ticket is the first one for the unit's key, a
+	key that is already cached is kept, the unit just couldn't join it */
+	void start (const GameMap& map, const UnitStore& units, int unit,
+			const Math::Point2i& from, int ticket)
+	{
+		if (entries.size() >= MAX_ENTRIES)
+			evict();
+		auto key = toKey(map, units, unit, from);
+		if (entries.find(key) != entries.end())
+			return ;
+		auto& entry = entries[key];
+		entry.ticket = ticket;
+		pending[ticket] = key;
+		misses++;
+	}
+
+	/* Stores the path found by the search with this ticket, versions are
+	the region versions the search saw. Returns the units that waited for it */
+	std::vector<UnitId> finish (const GameMap& map, int ticket,
+			const Path& path, const std::vector<int>& versions)
+	{
+		auto it = pending.find(ticket);
+		if (it == pending.end())
+			return {};
+		auto entryIt = entries.find(it->second);
+		pending.erase(it);
+		if (entryIt == entries.end() || entryIt->second.ticket != ticket)
+			return {};
+
+		auto& entry = entryIt->second;
+		auto followers = std::move(entry.followers);
+		auto& key = entryIt->first;
+		if (path.empty() || !(path.back() ==
+				Math::Point2i(std::get<1>(key), std::get<2>(key))))
+		{
+			entries.erase(entryIt);
+			return followers;
+		}
+		entry.ticket = 0;
+		entry.path = std::make_shared<const Path>(path);
+		entry.followers.clear();
+		for (auto&& tile : path) {
+			int region = map.getRegion(tile);
+			if (std::find(entry.regions.begin(), entry.regions.end(), region)
+					== entry.regions.end())
+			{
+				entry.regions.push_back(region);
+				entry.versions.push_back(versions[region]);
+			}
+		}
+		return followers;
+	}
+
+	/* drops the paths no unit walks anymore */
+	void evict() {
+		for (auto it = entries.begin(); it != entries.end(); ) {
+			if (!it->second.ticket && it->second.path.use_count() <= 1)
+				it = entries.erase(it);
+			else
+				++it;
+		}
+	}
+};
+
+#endif
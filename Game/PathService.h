@@ -0,0 +1,326 @@
+#ifndef PATH_SERVICE_H
+#define PATH_SERVICE_H
+
+#include <mutex>
+#include <thread>
+#include <memory>
+#include <vector>
+#include <condition_variable>
+
+#include "GameMap.h"
+#include "Unit.h"
+#include "PathCache.h"
+
+/* Path requests served by a pool of worker threads.
+
+Units don't search in intent(), they only mark that they want a path.
+Simulation::tick hands those requests to the service after the units moved and
+gets a ticket back for each, the ticket is kept in the Destination. Workers
+never read the GameMap, they search on a copy of the tile walkability taken on
+the main thread when the requests were submitted, so all the searches of one
+batch see the same map. Finished paths wait in the service until deliver() is
+called at the start of the next Simulation::tick, a result is only written to
+the Destination if it's ticket is still the one the Destination waits for, so
+a new order drops old results. Requests for a path that is already in the
+PathCache don't reach the workers. While a unit waits for it's result it walks
+the path one step of it's AnytimeSearch found, the search isn't advanced until
+the result comes. */
+
+class PathService {
+public:
+	constexpr static int INF = 1000'000'000;
+	constexpr static int STRAIGHT = 10;
+	constexpr static int DIAGONAL = 14;
+
+	struct Snapshot {
+		int width;
+		int height;
+		std::vector<char> free;
+		std::vector<int> versions;
+
+		Snapshot (const GameMap& map)
+		: width(map.width), height(map.height),
+		free(width * height),
+		versions(map.versions.begin(), map.versions.end())
+		{
+			for (int i = 0; i < height; i++)
+				for (int j = 0; j < width; j++)
+					free[i * width + j] = map.canAquire(i, j);
+		}
+
+		bool inside (const Math::Point2i& pos) const {
+			return pos.x >= 0 && pos.y >= 0 && pos.x < height && pos.y < width;
+		}
+
+		bool canAquire (const Math::Point2i& pos) const {
+			return inside(pos) && free[pos.x * width + pos.y];
+		}
+	};
+
+	struct Request {
+		int priority;
+		int ticket;
+		UnitId unit;
+		Math::Point2i from;
+		Math::Point2i to;
+		int maxIter;
+		std::shared_ptr<const Snapshot> snapshot;
+
+		bool operator > (const Request& oth) const {
+			if (priority != oth.priority)
+				return priority > oth.priority;
+			return ticket > oth.ticket;
+		}
+	};
+
+	struct Result {
+		int ticket;
+		UnitId unit;
+		Math::Point2i from;
+		std::vector<Math::Point2i> path;
+		std::shared_ptr<const Snapshot> snapshot;
+	};
+
+	/* per worker search memory, a node is fresh only if it's gen matches */
+	struct Worker {
+		std::vector<int> g;
+		std::vector<int> parent;
+		std::vector<int> gen;
+		int curGen = 0;
+		std::vector<std::pair<int, int>> open;
+	};
+
+	std::vector<std::thread> threads;
+	std::vector<Request> requests;
+	/* requests built by submit() before they are queued */
+	std::vector<Request> batch;
+	std::vector<Result> results;
+	PathCache cache;
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stop = false;
+	int lastTicket = 0;
+
+	/* hardware_concurrency() can be 0, at least one worker is started or
+	no ticket would ever be done */
+	PathService (int workers = std::max(1,
+			int(std::thread::hardware_concurrency()) - 1))
+	{
+		for (int i = 0; i < std::max(workers, 1); i++)
+			threads.emplace_back([this] { run(); });
+	}
+
+	~PathService() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		wake.notify_all();
+		for (auto&& thread : threads)
+			thread.join();
+	}
+
+	PathService (const PathService&) = delete;
+	PathService& operator = (const PathService&) = delete;
+
+	/* Queues the path requests of all the units that want one, lower priority
+	values are served first. Must be called from the thread that owns the map.
+	The PathCache and the Snapshot are only used by this thread, the lock is
+	only taken to hand the new requests to the workers */
+	void submit (const GameMap& map, UnitStore& units) {
+		std::shared_ptr<const Snapshot> snapshot;
+		batch.clear();
+		for (int i = 0; i < units.size(); i++) {
+			auto& dest = units.dest[i];
+			if (!dest.wantPath)
+				continue ;
+			auto from = map.getTilePos(units.pos[i]);
+			dest.wantPath = false;
+			if (!dest.reachable(map, from) && from == dest.finish)
+				continue ;
+			if (cache.join(map, units, i, from))
+				continue ;
+			if (!snapshot)
+				snapshot = std::make_shared<Snapshot>(map);
+			dest.ticket = ++lastTicket;
+			cache.start(map, units, i, from, dest.ticket);
+			batch.push_back(Request{
+				heuristic(from, dest.finish),
+				dest.ticket,
+				units.ids[i],
+				from,
+				dest.finish,
+				units.maxIter[i] * UnitStore::PLAN_ITER,
+				snapshot
+			});
+		}
+		if (batch.empty())
+			return ;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			for (auto&& req : batch) {
+				requests.push_back(std::move(req));
+				std::push_heap(requests.begin(), requests.end(),
+						std::greater<Request>());
+			}
+		}
+		wake.notify_all();
+	}
+
+	/* Hands the finished paths to their Destinations, called once per tick.
+	Units that moved away from where the search started drop the result */
+	void deliver (const GameMap& map, UnitStore& units) {
+		std::vector<Result> done;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			done.swap(results);
+		}
+		for (auto&& result : done) {
+			auto followers = cache.finish(map, result.ticket, result.path,
+					result.snapshot->versions);
+			for (auto&& follower : followers)
+				joinCache(map, units, follower, result.ticket);
+
+			int unit = units.index(result.unit);
+			if (unit < 0 || units.dest[unit].ticket != result.ticket)
+				continue ;
+			auto& dest = units.dest[unit];
+			dest.ticket = 0;
+			/* units walking an anytime path take the rest of the result
+			if they are on it, else their own search goes on */
+			auto tile = map.getTilePos(units.pos[unit]);
+			auto& path = result.path;
+			auto on = std::find(path.begin(), path.end(), tile);
+			if (!(tile == result.from) && on == path.end())
+				continue ;
+			if (on != path.end())
+				path.erase(path.begin(), on + 1);
+			dest.search.reset();
+			dest.setPath(std::move(path));
+		}
+	}
+
+	/* units that waited for another unit's search take the cached path, if
+	they can't they search on their own on the next submit */
+	void joinCache (const GameMap& map, UnitStore& units, const UnitId& id,
+			int ticket)
+	{
+		int unit = units.index(id);
+		if (unit < 0 || units.dest[unit].ticket != ticket)
+			return ;
+		auto& dest = units.dest[unit];
+		dest.ticket = 0;
+		if (cache.join(map, units, unit, map.getTilePos(units.pos[unit])))
+			return ;
+		if (dest.tries > 0) {
+			dest.tries--;
+			dest.wantPath = true;
+		}
+	}
+
+	void run() {
+		Worker worker;
+		while (true) {
+			Request req;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stop || !requests.empty(); });
+				if (stop)
+					return ;
+				std::pop_heap(requests.begin(), requests.end(),
+						std::greater<Request>());
+				req = std::move(requests.back());
+				requests.pop_back();
+			}
+			Result result{req.ticket, req.unit, req.from, {}, req.snapshot};
+			search(worker, *req.snapshot, req.from, req.to, req.maxIter,
+					result.path);
+			std::lock_guard<std::mutex> lock(mutex);
+			results.push_back(std::move(result));
+		}
+	}
+
+	static int heuristic (const Math::Point2i& a, const Math::Point2i& b) {
+		int dx = abs(a.x - b.x);
+		int dy = abs(a.y - b.y);
+		return std::min(dx, dy) * DIAGONAL + abs(dx - dy) * STRAIGHT;
+	}
+
+	/* A* limited to maxIter expansions, like UnitStore::path the path leads to
+	the closest tile to the finish that was found. The finish is walkable even
+	if a unit stands on it, units sent to a rally point share the path to it */
+	static void search (Worker& w, const Snapshot& snap,
+			const Math::Point2i& from, const Math::Point2i& to, int maxIter,
+			std::vector<Math::Point2i>& path)
+	{
+		int size = snap.width * snap.height;
+		if (w.gen.size() != size) {
+			w.g.assign(size, INF);
+			w.parent.assign(size, -1);
+			w.gen.assign(size, 0);
+			w.curGen = 0;
+		}
+		w.curGen++;
+		w.open.clear();
+
+		auto toId = [&] (const Math::Point2i& pos) {
+			return pos.x * snap.width + pos.y;
+		};
+		auto toPos = [&] (int id) {
+			return Math::Point2i(id / snap.width, id % snap.width);
+		};
+		auto touch = [&] (int id) {
+			if (w.gen[id] != w.curGen) {
+				w.gen[id] = w.curGen;
+				w.g[id] = INF;
+				w.parent[id] = -1;
+			}
+		};
+		auto cmp = std::greater<std::pair<int, int>>();
+
+		int start = toId(from);
+		int closest = start;
+		int closestH = heuristic(from, to);
+		touch(start);
+		w.g[start] = 0;
+		w.open.push_back({closestH, start});
+		while (!w.open.empty() && closestH > 0 && maxIter > 0) {
+			std::pop_heap(w.open.begin(), w.open.end(), cmp);
+			auto [f, id] = w.open.back();
+			w.open.pop_back();
+			auto pos = toPos(id);
+			if (f > w.g[id] + heuristic(pos, to))
+				continue ;
+			maxIter--;
+
+			for (int i = -1; i <= 1; i++)
+				for (int j = -1; j <= 1; j++) {
+					auto neigh = pos + Math::Point2i(i, j);
+					if ((!i && !j) || (!snap.canAquire(neigh) &&
+							!(neigh == to && snap.inside(to))))
+						continue ;
+					int nid = toId(neigh);
+					int ng = w.g[id] + (i && j ? DIAGONAL : STRAIGHT);
+					touch(nid);
+					if (ng >= w.g[nid])
+						continue ;
+					w.g[nid] = ng;
+					w.parent[nid] = id;
+					int h = heuristic(neigh, to);
+					if (h < closestH) {
+						closestH = h;
+						closest = nid;
+					}
+					w.open.push_back({ng + h, nid});
+					std::push_heap(w.open.begin(), w.open.end(), cmp);
+				}
+		}
+
+		path.clear();
+		for (int id = closest; id != start; id = w.parent[id])
+			path.push_back(toPos(id));
+		std::reverse(path.begin(), path.end());
+	}
+};
+
+#endif
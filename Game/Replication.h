@@ -0,0 +1,523 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <cmath>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+#include "GameMap.h"
+#include "Unit.h"
+
+/* Unit state sent from the server to the clients.
+
+A UnitSnapshot is the state of every unit slot of the UnitStore at one tick,
+quantized to what a client needs: the position in quarters of a tile, the
+heading in 256 steps, the number of tiles left on the path (at most
+PROGRESS_MAX), the owner and the low bits of the slot generation, so a client
+can tell a new unit in a reused slot from the old one.
+
+Packets are bit packed, fields take only the bits they need, counts and slot
+gaps are Elias gamma codes, small numbers take few bits. A keyframe has every
+live unit. A delta is relative to the last snapshot the client acknowledged
+and only has the slots that changed since: units that were removed, new units
+in full, and for the others a mask of the fields that changed. Most units move
+at most a tile per tick, their position is written as a small offset.
+
+The server keeps the last HISTORY snapshots, a client that acknowledged a tick
+that is no longer there, or nothing yet, gets a keyframe. The client keeps its
+decoded snapshots the same way, to have the baseline of the next delta. Buffers
+are reused, when the number of slots grows every snapshot of the history and
+the packet are grown to it at once, so encoding and decoding don't allocate
+while it stays the same. */
+
+/* Writes the low bits of values, the first bit written is the lowest bit of
+the first byte */
+class BitWriter {
+public:
+	std::vector<uint8_t>& out;
+	uint64_t acc = 0;
+	int count = 0;
+
+	BitWriter (std::vector<uint8_t>& out) : out(out) {
+		out.clear();
+	}
+
+	static uint32_t mask (int bits) {
+		return bits >= 32 ? ~0u : (1u << bits) - 1;
+	}
+
+	void write (uint32_t value, int bits) {
+		acc |= uint64_t(value & mask(bits)) << count;
+		count += bits;
+		while (count >= 8) {
+			out.push_back(acc);
+			acc >>= 8;
+			count -= 8;
+		}
+	}
+
+	/* value >= 1, 2 * floor(log2(value)) + 1 bits */
+	void writeGamma (uint32_t value) {
+		int n = 31 - __builtin_clz(value);
+		write(0, n);
+		write(1, 1);
+		write(value, n);
+	}
+
+	/* the last byte, padded with zeros */
+	void flush() {
+		if (count)
+			out.push_back(acc);
+		acc = 0;
+		count = 0;
+	}
+};
+
+class BitReader {
+public:
+	const uint8_t *data;
+	size_t size;
+	size_t at = 0;
+	bool overrun = false;
+
+	BitReader (const uint8_t *data, size_t size) : data(data), size(size) {}
+
+	uint32_t read (int bits) {
+		uint32_t value = 0;
+		for (int k = 0; k < bits; ) {
+			if (at >= size * 8) {
+				overrun = true;
+				return 0;
+			}
+			int off = at & 7;
+			int take = std::min(8 - off, bits - k);
+			value |= uint32_t((data[at >> 3] >> off) & ((1 << take) - 1)) << k;
+			k += take;
+			at += take;
+		}
+		return value;
+	}
+
+	uint32_t readGamma() {
+		int n = 0;
+		while (!read(1)) {
+			if (overrun || ++n > 31) {
+				overrun = true;
+				return 0;
+			}
+		}
+		return (1u << n) | read(n);
+	}
+};
+
+class UnitSnapshot {
+public:
+	constexpr static uint32_t NONE = ~0u;
+	constexpr static int SUB_BITS = 2;
+	constexpr static int HEADING_BITS = 8;
+	constexpr static int PROGRESS_BITS = 10;
+	constexpr static int PROGRESS_MAX = (1 << PROGRESS_BITS) - 1;
+	constexpr static int OWNER_BITS = 8;
+	constexpr static int GEN_BITS = 8;
+
+	uint32_t tick = NONE;
+	int width = 0;
+	int height = 0;
+	std::vector<uint8_t> alive;
+	std::vector<uint8_t> gen;
+	std::vector<uint32_t> x;
+	std::vector<uint32_t> y;
+	std::vector<uint8_t> heading;
+	std::vector<uint16_t> progress;
+	std::vector<uint8_t> owner;
+
+	int slots() const {
+		return alive.size();
+	}
+
+	void resize (int slots) {
+		alive.resize(slots);
+		gen.resize(slots);
+		x.resize(slots);
+		y.resize(slots);
+		heading.resize(slots);
+		progress.resize(slots);
+		owner.resize(slots);
+	}
+
+	/* number of bits of a number written with BitWriter::writeGamma */
+	static int gammaBits (uint32_t value) {
+		return 2 * (31 - __builtin_clz(value)) + 1;
+	}
+
+	/* bits of a position along a side of size tiles */
+	static int posBits (int size) {
+		uint32_t top = (uint32_t(std::max(size, 1)) << SUB_BITS) - 1;
+		return top ? 32 - __builtin_clz(top) : 1;
+	}
+
+	static uint32_t quantize (float world, float scale, int size) {
+		long q = std::lround(world / scale * (1 << SUB_BITS));
+		return std::clamp<long>(q, 0, (long(size) << SUB_BITS) - 1);
+	}
+
+	void capture (const GameMap& map, const UnitStore& units, uint32_t at) {
+		tick = at;
+		width = map.width;
+		height = map.height;
+		resize(units.gens.size());
+		std::fill(alive.begin(), alive.end(), 0);
+		for (int i = 0; i < units.size(); i++) {
+			int s = units.ids[i].slot;
+			auto& p = units.pos[i];
+			auto& d = units.dir[i];
+			auto& dest = units.dest[i];
+			alive[s] = 1;
+			gen[s] = units.ids[i].gen;
+			x[s] = quantize(p.x, map.scale, height);
+			y[s] = quantize(p.z, map.scale, width);
+			heading[s] = d.x || d.z ? std::lround(std::atan2(d.z, d.x) /
+					(2 * M_PI) * (1 << HEADING_BITS)) : 0;
+			progress[s] = std::min(std::max(dest.pathSize() - dest.next, 0),
+					PROGRESS_MAX);
+			owner[s] = units.player[i];
+		}
+	}
+
+	/* the slot holds the same unit in both, fields aside */
+	bool sameUnit (const UnitSnapshot& oth, int s) const {
+		return s < slots() && s < oth.slots() && alive[s] && oth.alive[s] &&
+				gen[s] == oth.gen[s];
+	}
+
+	bool equal (const UnitSnapshot& oth, int s) const {
+		return sameUnit(oth, s) && x[s] == oth.x[s] && y[s] == oth.y[s] &&
+				heading[s] == oth.heading[s] &&
+				progress[s] == oth.progress[s] && owner[s] == oth.owner[s];
+	}
+
+	/* true if the live units and their fields are the same in both */
+	bool operator == (const UnitSnapshot& oth) const {
+		int n = std::max(slots(), oth.slots());
+		for (int s = 0; s < n; s++) {
+			bool a = s < slots() && alive[s];
+			bool b = s < oth.slots() && oth.alive[s];
+			if (a != b || (a && !equal(oth, s)))
+				return false;
+		}
+		return true;
+	}
+
+	void writeUnit (BitWriter& out, int s) const {
+		out.write(gen[s], GEN_BITS);
+		out.write(x[s], posBits(height));
+		out.write(y[s], posBits(width));
+		out.write(heading[s], HEADING_BITS);
+		out.write(progress[s], PROGRESS_BITS);
+		out.write(owner[s], OWNER_BITS);
+	}
+
+	void readUnit (BitReader& in, int s) {
+		alive[s] = 1;
+		gen[s] = in.read(GEN_BITS);
+		x[s] = in.read(posBits(height));
+		y[s] = in.read(posBits(width));
+		heading[s] = in.read(HEADING_BITS);
+		progress[s] = in.read(PROGRESS_BITS);
+		owner[s] = in.read(OWNER_BITS);
+	}
+};
+
+/* Encodes and decodes the packets, see the top of the file */
+class Replication {
+public:
+	constexpr static int HISTORY = 64;
+	constexpr static int TICK_BITS = 32;
+	constexpr static int SIDE_BITS = 16;
+	constexpr static int SMALL_BITS = 4;
+	constexpr static int SMALL_MAX = (1 << (SMALL_BITS - 1)) - 1;
+
+	enum Field {
+		POS = 1,
+		HEADING = 2,
+		PROGRESS = 4,
+		OWNER = 8,
+		FIELDS = 4,
+	};
+
+	/* Bytes a keyframe or a delta of cur can take at most. A slot takes a gap,
+	two flags and at most as many bits as a new unit, a mask and a small
+	offset take less than the generation and the full position */
+	static size_t maxBytes (const UnitSnapshot& cur) {
+		size_t unit = UnitSnapshot::GEN_BITS +
+				UnitSnapshot::posBits(cur.height) +
+				UnitSnapshot::posBits(cur.width) + UnitSnapshot::HEADING_BITS +
+				UnitSnapshot::PROGRESS_BITS + UnitSnapshot::OWNER_BITS;
+		size_t slot = UnitSnapshot::gammaBits(cur.slots() + 1) + 2 + unit;
+		size_t head = 1 + 2 * TICK_BITS + 2 * SIDE_BITS +
+				3 * UnitSnapshot::gammaBits(~0u);
+		return (head + cur.slots() * slot + 7) / 8;
+	}
+
+	static uint32_t zigzag (int value) {
+		return (uint32_t(value) << 1) ^ uint32_t(value >> 31);
+	}
+
+	static int unzigzag (uint32_t value) {
+		return int(value >> 1) ^ -int(value & 1);
+	}
+
+	static void encodeKeyframe (const UnitSnapshot& cur,
+			std::vector<uint8_t>& packet)
+	{
+		BitWriter out(packet);
+		out.write(1, 1);
+		out.write(cur.tick, TICK_BITS);
+		out.write(cur.width, SIDE_BITS);
+		out.write(cur.height, SIDE_BITS);
+		out.writeGamma(cur.slots() + 1);
+		int count = 0;
+		for (int s = 0; s < cur.slots(); s++)
+			count += cur.alive[s];
+		out.writeGamma(count + 1);
+		int last = -1;
+		for (int s = 0; s < cur.slots(); s++) {
+			if (!cur.alive[s])
+				continue ;
+			out.writeGamma(s - last);
+			last = s;
+			cur.writeUnit(out, s);
+		}
+		out.flush();
+	}
+
+	static bool changed (const UnitSnapshot& cur, const UnitSnapshot& base,
+			int s)
+	{
+		bool now = s < cur.slots() && cur.alive[s];
+		bool was = s < base.slots() && base.alive[s];
+		return now != was || (now && !cur.equal(base, s));
+	}
+
+	static void encodeDelta (const UnitSnapshot& cur, const UnitSnapshot& base,
+			std::vector<uint8_t>& packet)
+	{
+		BitWriter out(packet);
+		out.write(0, 1);
+		out.write(cur.tick, TICK_BITS);
+		out.writeGamma(cur.tick - base.tick);
+		out.writeGamma(cur.slots() + 1);
+		int n = std::max(cur.slots(), base.slots());
+		int count = 0;
+		for (int s = 0; s < n; s++)
+			count += changed(cur, base, s);
+		out.writeGamma(count + 1);
+
+		int last = -1;
+		for (int s = 0; s < n; s++) {
+			if (!changed(cur, base, s))
+				continue ;
+			out.writeGamma(s - last);
+			last = s;
+			bool now = s < cur.slots() && cur.alive[s];
+			out.write(now, 1);
+			if (!now)
+				continue ;
+			bool fresh = !cur.sameUnit(base, s);
+			out.write(fresh, 1);
+			if (fresh) {
+				cur.writeUnit(out, s);
+				continue ;
+			}
+			int mask = (cur.x[s] != base.x[s] || cur.y[s] != base.y[s]) * POS |
+					(cur.heading[s] != base.heading[s]) * HEADING |
+					(cur.progress[s] != base.progress[s]) * PROGRESS |
+					(cur.owner[s] != base.owner[s]) * OWNER;
+			out.write(mask, FIELDS);
+			if (mask & POS) {
+				int dx = int(cur.x[s]) - int(base.x[s]);
+				int dy = int(cur.y[s]) - int(base.y[s]);
+				bool small = abs(dx) <= SMALL_MAX && abs(dy) <= SMALL_MAX;
+				out.write(small, 1);
+				if (small) {
+					out.write(zigzag(dx), SMALL_BITS);
+					out.write(zigzag(dy), SMALL_BITS);
+				}
+				else {
+					out.write(cur.x[s], UnitSnapshot::posBits(cur.height));
+					out.write(cur.y[s], UnitSnapshot::posBits(cur.width));
+				}
+			}
+			if (mask & HEADING)
+				out.write(cur.heading[s], UnitSnapshot::HEADING_BITS);
+			if (mask & PROGRESS)
+				out.write(cur.progress[s], UnitSnapshot::PROGRESS_BITS);
+			if (mask & OWNER)
+				out.write(cur.owner[s], UnitSnapshot::OWNER_BITS);
+		}
+		out.flush();
+	}
+};
+
+/* Server side, one for all the clients */
+class ReplicationServer {
+public:
+	std::vector<UnitSnapshot> history;
+	uint32_t latest = UnitSnapshot::NONE;
+	int slots = 0;
+
+	ReplicationServer() : history(Replication::HISTORY) {}
+
+	void capture (const GameMap& map, const UnitStore& units, uint32_t tick) {
+		if (units.gens.size() > slots) {
+			/* all at once, a slot first used HISTORY ticks later would
+			allocate then */
+			slots = units.gens.size();
+			for (auto&& snap : history)
+				snap.resize(slots);
+		}
+		history[tick % Replication::HISTORY].capture(map, units, tick);
+		latest = tick;
+	}
+
+	const UnitSnapshot *find (uint32_t tick) const {
+		if (tick == UnitSnapshot::NONE)
+			return NULL;
+		auto& snap = history[tick % Replication::HISTORY];
+		return snap.tick == tick ? &snap : NULL;
+	}
+
+	/* The packet of the latest snapshot for a client that acknowledged the
+	tick acked, NONE if it has nothing yet. Returns true for a keyframe */
+	bool encode (uint32_t acked, std::vector<uint8_t>& packet) const {
+		auto& cur = *find(latest);
+		auto base = acked < latest ? find(acked) : NULL;
+		packet.reserve(Replication::maxBytes(cur));
+		if (!base) {
+			Replication::encodeKeyframe(cur, packet);
+			return true;
+		}
+		Replication::encodeDelta(cur, *base, packet);
+		return false;
+	}
+};
+
+/* Client side, latest is the tick to acknowledge */
+class ReplicationClient {
+public:
+	std::vector<UnitSnapshot> history;
+	uint32_t latest = UnitSnapshot::NONE;
+	int slots = 0;
+
+	ReplicationClient() : history(Replication::HISTORY) {}
+
+	/* grows every snapshot of the history with the first packet that has
+	more slots, like the server does */
+	void grow (int count) {
+		if (count <= slots)
+			return ;
+		slots = count;
+		for (auto&& snap : history)
+			if (snap.slots() < count)
+				snap.resize(count);
+	}
+
+	const UnitSnapshot *find (uint32_t tick) const {
+		if (tick == UnitSnapshot::NONE)
+			return NULL;
+		auto& snap = history[tick % Replication::HISTORY];
+		return snap.tick == tick ? &snap : NULL;
+	}
+
+	const UnitSnapshot& state() const {
+		return *find(latest);
+	}
+
+	/* Returns false if the packet is broken or it's baseline is gone, the
+	client should acknowledge nothing then to get a keyframe */
+	bool decode (const uint8_t *data, size_t size) {
+		BitReader in(data, size);
+		bool key = in.read(1);
+		uint32_t tick = in.read(Replication::TICK_BITS);
+		auto& cur = history[tick % Replication::HISTORY];
+		if (key) {
+			cur.width = in.read(Replication::SIDE_BITS);
+			cur.height = in.read(Replication::SIDE_BITS);
+			int count = in.readGamma() - 1;
+			if (in.overrun)
+				return fail(cur);
+			grow(count);
+			cur.resize(count);
+			std::fill(cur.alive.begin(), cur.alive.end(), 0);
+			int alive = in.readGamma() - 1;
+			int s = -1;
+			for (int k = 0; k < alive && !in.overrun; k++) {
+				s += in.readGamma();
+				if (s >= cur.slots())
+					return fail(cur);
+				cur.readUnit(in, s);
+			}
+		}
+		else {
+			uint32_t back = in.readGamma();
+			auto base = find(tick - back);
+			if (in.overrun || !base || base == &cur)
+				return false;
+			int count = in.readGamma() - 1;
+			if (in.overrun)
+				return false;
+			grow(count);
+			cur = *base;
+			cur.resize(count);
+			for (int s = base->slots(); s < cur.slots(); s++)
+				cur.alive[s] = 0;
+			int changed = in.readGamma() - 1;
+			int s = -1;
+			for (int k = 0; k < changed && !in.overrun; k++) {
+				s += in.readGamma();
+				if (s >= cur.slots())
+					return fail(cur);
+				if (!in.read(1)) {
+					cur.alive[s] = 0;
+					continue ;
+				}
+				if (in.read(1)) {
+					cur.readUnit(in, s);
+					continue ;
+				}
+				int mask = in.read(Replication::FIELDS);
+				if (mask & Replication::POS) {
+					if (in.read(1)) {
+						int bits = Replication::SMALL_BITS;
+						cur.x[s] += Replication::unzigzag(in.read(bits));
+						cur.y[s] += Replication::unzigzag(in.read(bits));
+					}
+					else {
+						cur.x[s] = in.read(UnitSnapshot::posBits(cur.height));
+						cur.y[s] = in.read(UnitSnapshot::posBits(cur.width));
+					}
+				}
+				if (mask & Replication::HEADING)
+					cur.heading[s] = in.read(UnitSnapshot::HEADING_BITS);
+				if (mask & Replication::PROGRESS)
+					cur.progress[s] = in.read(UnitSnapshot::PROGRESS_BITS);
+				if (mask & Replication::OWNER)
+					cur.owner[s] = in.read(UnitSnapshot::OWNER_BITS);
+			}
+		}
+		if (in.overrun)
+			return fail(cur);
+		cur.tick = tick;
+		if (latest == UnitSnapshot::NONE || tick > latest)
+			latest = tick;
+		return true;
+	}
+
+	bool fail (UnitSnapshot& cur) {
+		cur.tick = UnitSnapshot::NONE;
+		return false;
+	}
+};
+
+#endif
@@ -0,0 +1,66 @@
+#ifndef SIM_CLOCK_H
+#define SIM_CLOCK_H
+
+#include <chrono>
+#include <cstdint>
+
+/* Fixed step clock for the simulation.
+
+Real time is added to an accumulator and the simulation runs one tick for every
+TICK seconds in it, so the game moves at the same speed whatever the frame rate
+is. After a slow frame at most MAX_STEPS ticks are run, the time past that is
+dropped and the game slows down for a moment instead of spending the next frames
+catching up. What is left in the accumulator is how far the render is between
+the last two ticks, alpha() is that as a fraction of a tick.
+
+tickMs and renderMs are running averages of how long a tick and a frame take,
+the time of one is not counted in the other. */
+
+class SimClock {
+public:
+	const static int TICK_RATE = 20;
+	const static int MAX_STEPS = 5;
+	constexpr static double TICK = 1.0 / TICK_RATE;
+	constexpr static double SMOOTH = 0.05;
+
+	double accumulator = 0;
+	double last = -1;
+	uint64_t ticks = 0;
+	uint64_t dropped = 0;
+	double tickMs = 0;
+	double renderMs = 0;
+
+	/* seconds from a fixed point */
+	static double now() {
+		using namespace std::chrono;
+		return duration<double>(steady_clock::now().time_since_epoch()).count();
+	}
+
+	static void average (double& avg, double ms) {
+		avg = avg == 0 ? ms : avg + (ms - avg) * SMOOTH;
+	}
+
+	/* Adds the time since the last call, returns how many ticks to run */
+	int advance (double time = now()) {
+		if (last < 0)
+			last = time;
+		accumulator += time - last;
+		last = time;
+		int steps = accumulator / TICK;
+		if (steps > MAX_STEPS) {
+			dropped += steps - MAX_STEPS;
+			accumulator -= TICK * (steps - MAX_STEPS);
+			steps = MAX_STEPS;
+		}
+		accumulator -= TICK * steps;
+		ticks += steps;
+		return steps;
+	}
+
+	/* how far the time is between the last tick and the next one, 0 to 1 */
+	float alpha() const {
+		return accumulator / TICK;
+	}
+};
+
+#endif
@@ -0,0 +1,112 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "GameMap.h"
+#include "Unit.h"
+#include "FlowField.h"
+#include "PathService.h"
+#include "Cooperative.h"
+#include "UnitUpdate.h"
+#include "SimClock.h"
+
+/* The state of a game and the tick that advances it. Nothing in here needs a
+window or a GL context, the client draws it and the headless server only runs
+it. */
+
+class Simulation {
+public:
+	const static int FLOW_MIN_GROUP = 4;
+	const static int COOP_MIN_GROUP = 2;
+
+	GameMap map;
+	UnitStore units;
+	FlowFieldCache flowFields;
+	PathService pathService;
+	CooperativePlanner cooperative;
+	UnitUpdate unitUpdate;
+	SimClock clock;
+
+	/* threads is the number of threads moving the units, the PathService
+	searches on one less, 0 for as many as the machine has */
+	Simulation (int mapWidth, int mapHeight, int threads = 0)
+	: map(mapWidth, mapHeight),
+	pathService(threads ? threads - 1 :
+			int(std::thread::hardware_concurrency()) - 1),
+	unitUpdate(threads ? threads :
+			int(std::thread::hardware_concurrency())) {}
+
+	/* returns an invalid id if the tile is taken */
+	UnitId spawnUnit (int player, int type, int i, int j) {
+		if (!map.aquire(i, j))
+			return UnitId();
+		auto id = units.create(player, type, UnitStore::TANK,
+				Math::Point3f(i, 0, j) * map.scale);
+		units.dest[units.index(id)].setFinish(Math::Point2i(i, j));
+		return id;
+	}
+
+	void removeUnit (const UnitId& id) {
+		int i = units.index(id);
+		if (i < 0)
+			return ;
+		map.release(map.getTilePos(units.pos[i]));
+		cooperative.table.release(id);
+		units.destroy(id);
+	}
+
+	/* Sends the units to the tile. Big groups walk a flow field, shared with
+	other groups sent to the same tile, and only plan cooperatively where they
+	jam. Small groups plan cooperatively all the way */
+	void order (const std::vector<UnitId>& ids, const Math::Point2i& tile) {
+		if (ids.size() >= FLOW_MIN_GROUP) {
+			auto field = flowFields.get(map, tile);
+			for (auto&& id : ids) {
+				int unit = units.index(id);
+				if (unit >= 0)
+					units.dest[unit].setFlow(field);
+			}
+		}
+		else if (ids.size() >= COOP_MIN_GROUP) {
+			auto field = std::make_shared<FlowField>(map, tile);
+			for (auto&& id : ids) {
+				int unit = units.index(id);
+				if (unit >= 0)
+					units.dest[unit].setCooperative(field);
+			}
+		}
+		else {
+			for (auto&& id : ids) {
+				int unit = units.index(id);
+				if (unit >= 0)
+					units.dest[unit].setFinish(tile);
+			}
+		}
+	}
+
+	/* runs the ticks that are due since the last frame */
+	void update() {
+		int steps = clock.advance();
+		for (int i = 0; i < steps; i++) {
+			double start = SimClock::now();
+			tick();
+			SimClock::average(clock.tickMs, (SimClock::now() - start) * 1000);
+		}
+	}
+
+	/* One step of the simulation, the poses the units had before it are kept
+	for the render to interpolate from */
+	void tick() {
+		units.lastPos = units.pos;
+		map.updateComponents();
+		pathService.deliver(map, units);
+		cooperative.step(map, units);
+		unitUpdate.step(map, units);
+		pathService.submit(map, units);
+	}
+};
+
+#endif
\ No newline at end of file
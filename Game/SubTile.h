@@ -6,11 +6,11 @@
 class SubTile {
 public:
 	bool empty = true;
-	std::shared_ptr<Unit> unitPtr;
+	UnitId unit;
 
 	// void render (DrawContext& drawContext, ShaderProgram &shader) {
-	// 	if (unitPtr)
-	// 		unitPtr->render(drawContext, shader);
+	// 	if (unit.valid())
+	// 		units.render(drawContext, shader, unit);
 	// }
 };
 
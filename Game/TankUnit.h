@@ -1,13 +1,12 @@
 #ifndef TANK_UNIT_H
 #define TANK_UNIT_H
 
-#include "Unit.h"
+#include "ShaderProgram.h"
 
-class TankUnit : public Unit {
-public:
-	// will have a static mesh
-	// and other props
+/* Model of the units with the TANK model, drawn by the UnitRender */
 
+class TankUnit {
+public:
 	using TankVertexType = Vertex<
 		Math::Point3f,	VertexPosition,
 		Math::Point3f,	VertexNormal,
@@ -15,17 +14,13 @@ public:
 		Math::Point2f,	VertexTexCoord
 	>;
 
-	TankUnit (int player = 0, int type = 0)
-	: Unit(player, type)
-	{}
-
-	Mesh<TankVertexType> createModel() {
+	static Mesh<TankVertexType> createModel() {
 		Mesh<TankVertexType> tank;
 		Util::addCube(tank, 3, Math::Vec4f(0.44, 0.9, 0.1, 1));
 		return tank;
 	}
 
-	DeprecatedVBOMeshDraw& getModel() {
+	static DeprecatedVBOMeshDraw& getModel() {
 		// static Mesh<TankVertexType> mTank = 
 		// 		OBJLoader<TankVertexType>().loadMesh(
 		// 			"Obj/TankNoTex/", "T-90.obj");
@@ -39,14 +34,15 @@ public:
 		return gTank;
 	}
 
-	virtual void render (DrawContext& drawContext,
-			ShaderProgram &defaultShader)
+	static void render (DrawContext& drawContext,
+			ShaderProgram &defaultShader, const Math::Point3f& at,
+			int player)
 	{
 		defaultShader.useProgram();
 		defaultShader.setMatrix("projectionMatrix", drawContext.proj);
 		defaultShader.setMatrix("viewMatrix", drawContext.view);
 		defaultShader.setMatrix("worldMatrix", 
-				Math::translation<float>(pos) *
+				Math::translation<float>(at) *
 				drawContext.world * Math::scale4<float>(4, 4, 4));
 		glColor4fv(
 			Math::Point4f(
@@ -4,155 +4,263 @@
 #include <set>
 #include <map>
 #include <queue>
+#include <vector>
+#include <cmath>
+#include <cstdint>
 #include <utility>
 
-#include "ShaderProgram.h"
 #include "Destination.h"
 #include "GameMap.h"
 
-class Unit {
+/* Handle to a unit of the UnitStore: the slot it was given and the generation
+of that slot. When a unit is removed the generation of it's slot changes, so
+handles kept by the selection, the PathService or the PathCache stop finding it
+instead of finding the unit that takes the slot next. */
+
+struct UnitId {
+	constexpr static uint32_t NONE = ~0u;
+
+	uint32_t slot = NONE;
+	uint32_t gen = 0;
+
+	bool valid() const {
+		return slot != NONE;
+	}
+
+	uint64_t key() const {
+		return (uint64_t(gen) << 32) | slot;
+	}
+
+	bool operator == (const UnitId& oth) const {
+		return slot == oth.slot && gen == oth.gen;
+	}
+};
+
+/* All the units of the game, one array per component.
+
+Unit i is the i-th element of every array, the arrays are dense: removing a
+unit moves the last one in it's place, handles go trough the slots to find
+where a unit is now. The systems below work on one index or loop over the
+arrays, they are plain calls. Moving the units is done by the UnitUpdate with
+intent() and stepTo(), drawing them by the UnitRender, which picks the model
+by the model index instead of a virtual method. */
+
+class UnitStore {
 public:
-	const static int DEFAULT_MAX_ITER = 128;
+	constexpr static int DEFAULT_MAX_ITER = 128;
+	constexpr static int PLAN_ITER = 16;
 
-	int player = 0;
-	int type = 0;
-	int maxIter = DEFAULT_MAX_ITER;
+	enum Model : int {
+		MARKER,
+		TANK,
+	};
 
-	Math::Point3f pos;
-	Math::Point3f dir;
+	std::vector<UnitId> ids;
+	std::vector<int> player;
+	std::vector<int> type;
+	std::vector<int> model;
+	std::vector<int> maxIter;
+	std::vector<Math::Point3f> pos;
+	std::vector<Math::Point3f> lastPos;
+	/* the last step the unit made, it faces that way */
+	std::vector<Math::Point3f> dir;
+	std::vector<Destination> dest;
 
-	Destination dest;
+	/* slot -> index in the arrays, generation of each slot */
+	std::vector<uint32_t> dense;
+	std::vector<uint32_t> gens;
+	std::vector<uint32_t> freeSlots;
 
-	Unit (int player = 0, int type = 0)
-	: player(player), type(type) {}
+	int size() const {
+		return ids.size();
+	}
 
-	virtual void move (GameMap& map) {
-		if (map.canAquire(dest.getNext()) && !dest.finishedPath()) {
-			map.release(map.getTilePos(pos));
-			pos = map.toWorld(dest.getNext());
-			map.aquire(dest.advance());
+	UnitId create (int unitPlayer, int unitType, int unitModel,
+			const Math::Point3f& unitPos)
+	{
+		UnitId id;
+		if (freeSlots.size()) {
+			id.slot = freeSlots.back();
+			freeSlots.pop_back();
 		}
 		else {
-			if (dest.path.size() < dest.next)
-				dest.clearPath();
-			else if (dest.path.size() > 0)
-				dest.path.pop_back();
-			else if (dest.tries > 0) {
-				dest.tries--;
-				path(map);	// maybe add a thread pool here?
-							// and join threads in another function?
-			}
+			id.slot = gens.size();
+			gens.push_back(0);
+			dense.push_back(0);
 		}
+		id.gen = gens[id.slot];
+		dense[id.slot] = ids.size();
+		ids.push_back(id);
+		player.push_back(unitPlayer);
+		type.push_back(unitType);
+		model.push_back(unitModel);
+		maxIter.push_back(DEFAULT_MAX_ITER);
+		pos.push_back(unitPos);
+		lastPos.push_back(unitPos);
+		dir.push_back(Math::Point3f());
+		dest.emplace_back();
+		return id;
 	}
 
-	void path (GameMap& map) {
-		dest.clearPath();
-		int iterLeft = maxIter;
-
-		using namespace Math;
-		float inf = map.height * map.width * 100;
-		
-		auto posHash = [&] (const auto& pos) -> int {
-			return map.height * pos.x + pos.y;
-		};
-
-		auto posEq = [&] (const auto& left, const auto& right) {
-			return posHash(left) == posHash(right);
-		};
-
-		std::unordered_map<Point2i, Point2i, decltype(posHash), decltype(posEq)>
-		prev(size_t(180), posHash, posEq);
-		
-		std::unordered_map<Point2i, float, decltype(posHash), decltype(posEq)>
-		tDist(size_t(180), posHash, posEq);
-		
-		std::unordered_map<Point2i, float, decltype(posHash), decltype(posEq)>
-		hDist(size_t(180), posHash, posEq);
-
-		auto getTDist = [&] (auto pos) {
-			if (tDist.find(pos) == tDist.end())
-				tDist[pos] = inf;
-			return tDist[pos];
-		};
-
-		auto getHDist = [&] (auto pos) {
-			if (hDist.find(pos) == hDist.end())
-				hDist[pos] = inf;
-			return hDist[pos];
-		};
-
-		auto cmp = [&] (auto left, auto right) -> bool {
-			return left.second > right.second;
-		};
-
-		auto squareNorm = [] (auto point) -> float {
-			return (point.tr() * point).x;
-		};
-
-		std::priority_queue<std::pair<Point2i, float>,
-				std::vector<std::pair<Point2i, float>>, decltype(cmp)> que(cmp);
-		auto start = map.getTilePos(pos);
-		auto closest = start;
-
-		tDist[start] = 0;
-		hDist[start] = (Point2f(dest.finish) - Point2f(start)).norm2();
-		que.push(std::pair<Point2i, float>(start, tDist[start]));
-		while (!que.empty() && squareNorm(closest - dest.finish) > 0.001 && iterLeft > 0) {
-			if (que.top().second > getHDist(que.top().first)) {
-				que.pop();
-			}
-			else {
-				iterLeft--;
-				auto node = que.top().first;
-				que.pop();
-
-				for (int i = 0; i < 9; i++) {
-					auto neigh = node + Point2i(i % 3 - 1, i / 3 - 1);
-					if (!map.inside(neigh) || i == 3 || !map.canAquire(neigh))
-						continue;
-					if (squareNorm(Point2f(closest - dest.finish)) >
-							squareNorm(Point2f(neigh - dest.finish)))
-						closest = neigh;
-					float score = getTDist(node)
-							+ (Point2f(node) - Point2f(neigh)).norm2();
-					if (score < getTDist(neigh)) {
-						hDist[neigh] = getTDist(node)
-								+ (Point2f(node) - Point2f(neigh)).norm2()
-								+ (Point2f(dest.finish) - Point2f(neigh)).norm2();
-						tDist[neigh] = score;
-						que.push(std::pair<Point2i, float>(neigh, hDist[neigh]));
-						prev[neigh] = node;
-					}
+	/* index of the unit in the arrays, -1 if it was removed */
+	int index (const UnitId& id) const {
+		if (!id.valid() || id.slot >= gens.size() || gens[id.slot] != id.gen)
+			return -1;
+		return dense[id.slot];
+	}
+
+	void destroy (const UnitId& id) {
+		int i = index(id);
+		if (i < 0)
+			return ;
+		int last = size() - 1;
+		if (i != last) {
+			ids[i] = ids[last];
+			player[i] = player[last];
+			type[i] = type[last];
+			model[i] = model[last];
+			maxIter[i] = maxIter[last];
+			pos[i] = pos[last];
+			lastPos[i] = lastPos[last];
+			dir[i] = dir[last];
+			dest[i] = std::move(dest[last]);
+			dense[ids[i].slot] = i;
+		}
+		ids.pop_back();
+		player.pop_back();
+		type.pop_back();
+		model.pop_back();
+		maxIter.pop_back();
+		pos.pop_back();
+		lastPos.pop_back();
+		dir.pop_back();
+		dest.pop_back();
+		gens[id.slot]++;
+		freeSlots.push_back(id.slot);
+	}
+
+	/* Returns false if the unit should plan on it's own instead, next is
+	the tile the field leads to. A unit that found no free tile closer to the
+	target for CONGESTED ticks plans one window with the CooperativePlanner,
+	after MAX_BLOCKED ticks without moving it leaves the field. Both wait
+	longer in a bigger group, the rows in front have to move first, and a
+	blocked unit inside the place the group fills at the target stops there */
+	bool followFlow (const GameMap& map, int i, Math::Point2i& next) {
+		auto& d = dest[i];
+		auto tile = map.getTilePos(pos[i]);
+		if (tile == d.finish)
+			return true;
+		if (!d.flow->settle(map, tile, maxIter[i] * PLAN_ITER))
+			return true;
+		if (!d.flow->reachable(tile)) {
+			d.flow.reset();
+			return false;
+		}
+		if (d.flow->next(map, tile, next)) {
+			d.blocked = 0;
+			return true;
+		}
+		next = tile;
+		int units = d.flow.use_count();
+		bool waited = d.blocked + 1 >= Destination::CONGESTED;
+		if (d.flow->arrived(tile, units, waited)) {
+			/* keeps the field, the group stays the same size for the ones
+			still coming */
+			d.finish = tile;
+			d.blocked = 0;
+			return true;
+		}
+		int rows = std::sqrt(units);
+		if (++d.blocked == Destination::CONGESTED + rows) {
+			d.cooperative = true;
+			d.congested = true;
+			return true;
+		}
+		if (d.blocked < Destination::MAX_BLOCKED + rows)
+			return true;
+		d.flow.reset();
+		d.blocked = 0;
+		return false;
+	}
+
+	/* The tile the unit wants to step on this tick, it's own tile if it
+	stays. Tiles are only read, so the units of a tick all decide on the map
+	as it was when the tick started. Units with a flow field change the field,
+	the others only their own components */
+	Math::Point2i intent (const GameMap& map, int i) {
+		auto& d = dest[i];
+		auto tile = map.getTilePos(pos[i]);
+		/* moved by the CooperativePlanner */
+		if (d.cooperative)
+			return tile;
+		/* an enclosed finish would cost a whole search, and the field
+		would flood all it can reach */
+		d.reachable(map, tile);
+		auto next = tile;
+		if (d.flow && followFlow(map, i, next))
+			return next;
+		/* while the PathService searches, walk the path one step of the
+		anytime search finds, advancing it would repeat the worker's search */
+		if (d.ticket ? !d.search.active && d.finishedPath() : d.search.active)
+			path(map, i);
+		if (map.canAquire(d.getNext()) && !d.finishedPath())
+			return d.getNext();
+		if (!(tile == d.finish) && d.tries > 0 &&
+				d.tries == Destination::MAX_TRIES)
+		{
+			/* the first path of an order comes from the PathService, so
+			units sent to the same place share it trough the PathCache.
+			Simulation::tick submits the request at the end of the tick */
+			d.tries--;
+			d.wantPath = true;
+		}
+		else if (!(tile == d.finish) && d.tries > 0 && !d.search.active) {
+			/* the planner only repairs what changed since the last call,
+			while it has no path walk towards the closest reachable tile,
+			that path is searched by the PathService. Only count a try if
+			the planner is done, found nothing and no search is running */
+			if (!d.replan(map, tile, maxIter[i] * PLAN_ITER)) {
+				if (!d.planner.pending && !d.ticket) {
+					d.tries--;
+					d.wantPath = true;
 				}
 			}
 		}
+		return tile;
+	}
 
-		while (prev.find(closest) != prev.end()) {
-			dest.path.push_back(closest);
-			closest = prev[closest];
-		}
-		std::reverse(dest.path.begin(), dest.path.end());
+	/* moves the unit to the tile it wanted, the tile is already taken for
+	it */
+	void stepTo (GameMap& map, int i, const Math::Point2i& to) {
+		map.release(map.getTilePos(pos[i]));
+		dir[i] = map.toWorld(to) - pos[i];
+		pos[i] = map.toWorld(to);
+		if (!dest[i].flow)
+			dest[i].advance();
 	}
 
-	virtual void render (DrawContext& drawContext,
-			ShaderProgram &defaultShader)
-	{
-		defaultShader.useProgram();
-		defaultShader.setMatrix("projectionMatrix", drawContext.proj);
-		defaultShader.setMatrix("viewMatrix", drawContext.view);
-		defaultShader.setMatrix("worldMatrix", 
-				Math::translation<float>(pos) *
-				drawContext.world);
-		Util::drawLine(
-			Math::Point3f(0, 0, 0),
-			Math::Point3f(0, 10, 0),
-			Math::Point4f(
-				player % 2,
-				(player / 2) % 2,
-				(player / 4) % 2,
-				1
-			)
-		);
+	/* Advances the anytime search of the unit by maxIter nodes and takes the
+	best path it knows so far. The search is kept between calls, it only starts
+	over for a new finish or if the unit left the tiles it reached */
+	void path (const GameMap& map, int i) {
+		auto& d = dest[i];
+		auto& search = d.search;
+		auto tile = map.getTilePos(pos[i]);
+		std::vector<Math::Point2i> partial;
+		if (!search.active || !(search.goal == d.finish) ||
+				!search.pathFrom(tile, partial))
+			search.init(map, tile, d.finish, maxIter[i] * PLAN_ITER);
+		search.step(map, maxIter[i]);
+		search.pathFrom(tile, partial);
+		d.setPath(std::move(partial));
+		if (search.done)
+			search.reset();
+	}
+
+	/* where the unit is drawn, alpha of the way from the pose before the last
+	tick to the current one */
+	Math::Point3f renderPos (int i, float alpha) const {
+		return lastPos[i] + (pos[i] - lastPos[i]) * alpha;
 	}
 };
 
@@ -0,0 +1,49 @@
+#ifndef UNIT_RENDER_H
+#define UNIT_RENDER_H
+
+#include "ShaderProgram.h"
+#include "Unit.h"
+#include "TankUnit.h"
+
+/* Draws the units of a UnitStore at their interpolated poses with the model
+each one has */
+
+class UnitRender {
+public:
+	static void render (DrawContext& drawContext,
+			ShaderProgram &defaultShader, const UnitStore& units)
+	{
+		for (int i = 0; i < units.size(); i++) {
+			auto at = units.renderPos(i, drawContext.alpha);
+			if (units.model[i] == UnitStore::TANK)
+				TankUnit::render(drawContext, defaultShader, at,
+						units.player[i]);
+			else
+				renderMarker(drawContext, defaultShader, at, units.player[i]);
+		}
+	}
+
+	static void renderMarker (DrawContext& drawContext,
+			ShaderProgram &defaultShader, const Math::Point3f& at,
+			int player)
+	{
+		defaultShader.useProgram();
+		defaultShader.setMatrix("projectionMatrix", drawContext.proj);
+		defaultShader.setMatrix("viewMatrix", drawContext.view);
+		defaultShader.setMatrix("worldMatrix",
+				Math::translation<float>(at) *
+				drawContext.world);
+		Util::drawLine(
+			Math::Point3f(0, 0, 0),
+			Math::Point3f(0, 10, 0),
+			Math::Point4f(
+				player % 2,
+				(player / 2) % 2,
+				(player / 4) % 2,
+				1
+			)
+		);
+	}
+};
+
+#endif
\ No newline at end of file
@@ -0,0 +1,114 @@
+#ifndef UNIT_UPDATE_H
+#define UNIT_UPDATE_H
+
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#include "GameMap.h"
+#include "Unit.h"
+#include "FlowField.h"
+#include "WorkPool.h"
+
+/* Moves the units of one tick on the threads of a WorkPool.
+
+The tick is done in phases, each one a loop over all the units:
+ - every unit decides the tile it wants (UnitStore::intent). Nothing is taken
+or released yet, so all the units read the same map. Units walking a flow field
+decide first. Their field is shared with their group and grows while they read
+it, so each field is one task and it's units decide in index order in it, the
+fields run in parallel.
+ - every unit that wants to move claims the tile. A claim keeps the lowest
+priority written to it, by compare and swap.
+ - the units that hold the claim of their tile take it and release theirs.
+ - the claims are cleared.
+The priority of a unit is it's index in the UnitStore rotated by the tick
+count, so no unit loses every time. Which units move only depends on the state
+at the start of the tick, the number of threads and their timing don't change
+it. A tile that is left in a tick can be taken in the next one. */
+
+class UnitUpdate {
+public:
+	constexpr static uint32_t NONE = ~0u;
+
+	WorkPool pool;
+	std::vector<std::atomic<uint32_t>> claims;
+	std::vector<Math::Point2i> wanted;
+	std::vector<char> decided;
+	/* units walking a flow field sorted by field, and where each field
+	starts */
+	std::vector<std::pair<const FlowField *, int>> followers;
+	std::vector<int> fieldStart;
+	uint32_t tick = 0;
+
+	UnitUpdate (int workers = std::max(1u,
+			std::thread::hardware_concurrency()))
+	: pool(std::max(workers, 1)) {}
+
+	void step (GameMap& map, UnitStore& units) {
+		int n = units.size();
+		if (claims.size() != map.width * map.height) {
+			claims = std::vector<std::atomic<uint32_t>>(map.width * map.height);
+			for (auto&& claim : claims)
+				claim.store(NONE, std::memory_order_relaxed);
+		}
+		wanted.resize(n);
+		decided.assign(n, false);
+
+		followers.clear();
+		for (int i = 0; i < n; i++)
+			if (units.dest[i].flow && !units.dest[i].cooperative)
+				followers.push_back({units.dest[i].flow.get(), i});
+		std::sort(followers.begin(), followers.end());
+		fieldStart.clear();
+		for (int k = 0; k < followers.size(); k++)
+			if (!k || followers[k].first != followers[k - 1].first)
+				fieldStart.push_back(k);
+		fieldStart.push_back(followers.size());
+		/* a unit can drop it's field, the ones after it in the task still
+		hold it */
+		pool.parallelFor(fieldStart.size() - 1, [&] (int f) {
+			for (int k = fieldStart[f]; k < fieldStart[f + 1]; k++) {
+				int i = followers[k].second;
+				wanted[i] = units.intent(map, i);
+				decided[i] = true;
+			}
+		}, 1);
+		pool.parallelFor(n, [&] (int i) {
+			if (!decided[i])
+				wanted[i] = units.intent(map, i);
+		});
+
+		auto moves = [&] (int i) {
+			return !(wanted[i] == map.getTilePos(units.pos[i]));
+		};
+		auto priority = [&] (int i) {
+			return uint32_t((i + uint64_t(tick)) % n);
+		};
+		pool.parallelFor(n, [&] (int i) {
+			if (!moves(i))
+				return ;
+			auto& claim = claims[map.toId(wanted[i].x, wanted[i].y)];
+			uint32_t prio = priority(i);
+			uint32_t cur = claim.load(std::memory_order_relaxed);
+			while (prio < cur && !claim.compare_exchange_weak(cur, prio,
+					std::memory_order_relaxed));
+		});
+		pool.parallelFor(n, [&] (int i) {
+			if (!moves(i))
+				return ;
+			auto& claim = claims[map.toId(wanted[i].x, wanted[i].y)];
+			if (claim.load(std::memory_order_relaxed) == priority(i) &&
+					map.aquire(wanted[i]))
+				units.stepTo(map, i, wanted[i]);
+		});
+		pool.parallelFor(n, [&] (int i) {
+			claims[map.toId(wanted[i].x, wanted[i].y)].store(NONE,
+					std::memory_order_relaxed);
+		});
+		tick++;
+	}
+};
+
+#endif
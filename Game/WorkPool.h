@@ -0,0 +1,161 @@
+#ifndef WORK_POOL_H
+#define WORK_POOL_H
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <functional>
+#include <condition_variable>
+
+/* Work stealing pool for loops over the units.
+
+parallelFor() splits the indices in one range per thread, the thread calling
+it works on the first one. A thread takes grain indices at a time from the
+front of it's range and when it runs out it steals the back half of the range
+of another thread. Loops over units use GRAIN, loops over bigger pieces of work
+a smaller grain, so they still spread over the threads. A range is it's begin
+and end packed in one atomic, taking and stealing are a compare and swap on it,
+no locks. The mutex is only used to start the threads on a loop and to wait for
+the loop to end, which also makes everything written in the loop visible after
+parallelFor() returns. */
+
+class WorkPool {
+public:
+	const static int GRAIN = 32;
+
+	struct alignas(64) Range {
+		std::atomic<uint64_t> span{0};
+	};
+
+	int count;
+	std::unique_ptr<Range[]> ranges;
+	std::vector<std::thread> threads;
+	const std::function<void (int)> *job = nullptr;
+	int grain = GRAIN;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable finished;
+	uint64_t round = 0;
+	int running = 0;
+	bool stop = false;
+
+	WorkPool (int workers = std::max(1u, std::thread::hardware_concurrency()))
+	: count(std::max(workers, 1)), ranges(new Range[count])
+	{
+		for (int i = 1; i < count; i++)
+			threads.emplace_back([this, i] { run(i); });
+	}
+
+	~WorkPool() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		wake.notify_all();
+		for (auto&& thread : threads)
+			thread.join();
+	}
+
+	WorkPool (const WorkPool&) = delete;
+	WorkPool& operator = (const WorkPool&) = delete;
+
+	static uint64_t pack (uint32_t begin, uint32_t end) {
+		return (uint64_t(end) << 32) | begin;
+	}
+
+	/* calls fn(i) for every i in [0, n), returns when all the calls are done */
+	void parallelFor (int n, const std::function<void (int)>& fn,
+			int step = GRAIN)
+	{
+		if (count == 1 || n <= step) {
+			for (int i = 0; i < n; i++)
+				fn(i);
+			return ;
+		}
+		for (int w = 0; w < count; w++)
+			ranges[w].span.store(pack(int64_t(n) * w / count,
+					int64_t(n) * (w + 1) / count));
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			job = &fn;
+			grain = step;
+			round++;
+			running = count - 1;
+		}
+		wake.notify_all();
+		work(0);
+		std::unique_lock<std::mutex> lock(mutex);
+		finished.wait(lock, [this] { return running == 0; });
+		job = nullptr;
+	}
+
+	void run (int self) {
+		uint64_t seen = 0;
+		while (true) {
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return stop || round != seen; });
+				if (stop)
+					return ;
+				seen = round;
+			}
+			work(self);
+			std::lock_guard<std::mutex> lock(mutex);
+			if (--running == 0)
+				finished.notify_one();
+		}
+	}
+
+	/* takes at most grain indices from the front of the range of self */
+	bool take (int self, uint32_t& begin, uint32_t& end) {
+		auto& span = ranges[self].span;
+		uint64_t cur = span.load();
+		while (true) {
+			uint32_t b = cur;
+			uint32_t e = cur >> 32;
+			if (b >= e)
+				return false;
+			uint32_t to = std::min<uint32_t>(e, b + grain);
+			if (span.compare_exchange_weak(cur, pack(to, e))) {
+				begin = b;
+				end = to;
+				return true;
+			}
+		}
+	}
+
+	/* moves the back half of the range of another thread to self, only
+	called once the range of self is empty */
+	bool steal (int self) {
+		for (int k = 1; k < count; k++) {
+			auto& span = ranges[(self + k) % count].span;
+			uint64_t cur = span.load();
+			while (true) {
+				uint32_t b = cur;
+				uint32_t e = cur >> 32;
+				if (b >= e)
+					break ;
+				uint32_t mid = b + (e - b) / 2;
+				if (span.compare_exchange_weak(cur, pack(b, mid))) {
+					ranges[self].span.store(pack(mid, e));
+					return true;
+				}
+			}
+		}
+		return false;
+	}
+
+	void work (int self) {
+		uint32_t begin, end;
+		do {
+			while (take(self, begin, end))
+				for (uint32_t i = begin; i < end; i++)
+					(*job)(i);
+		} while (steal(self));
+	}
+};
+
+#endif
@@ -0,0 +1,80 @@
+#ifndef WORKLOAD_H
+#define WORKLOAD_H
+
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "Simulation.h"
+
+/* The busy server the headless benchmarks run.
+
+A square map with room for about UNITS_PER_TILE units per tile, a tenth of the
+tiles are walls and the units are spawned on random free tiles. Every tick one
+in ORDER_TICKS units gets a new order, alone or in a group, to a tile near it,
+the way the players of a busy server click. */
+
+class Workload {
+public:
+	const static int ORDER_TICKS = 200;
+	const static int ORDER_RANGE = 48;
+	constexpr static float UNITS_PER_TILE = 0.1;
+	constexpr static int GROUP_SIZES[] = {1, 1, 3, 8, 24};
+
+	static int side (int count) {
+		return std::max(64, int(std::sqrt(count / UNITS_PER_TILE)));
+	}
+
+	int count;
+	Simulation sim;
+	std::mt19937 rng;
+	std::vector<UnitId> group;
+	int ordered = 0;
+	int ticks = 0;
+
+	Workload (int count, int threads = 0)
+	: count(count), sim(side(count), side(count), threads), rng(1)
+	{
+		int n = side(count);
+		for (int k = 0; k < n * n / 10; k++)
+			sim.map.setWall(rng() % n, rng() % n, true);
+		while (sim.units.size() < count)
+			sim.spawnUnit(rng() % 4 + 1, 1, rng() % n, rng() % n);
+	}
+
+	/* new orders for about n units */
+	void giveOrders (int n) {
+		auto& units = sim.units;
+		int kinds = sizeof(GROUP_SIZES) / sizeof(GROUP_SIZES[0]);
+		while (n > 0) {
+			int size = std::min(n, GROUP_SIZES[rng() % kinds]);
+			int first = rng() % units.size();
+			group.clear();
+			for (int k = 0; k < size; k++)
+				group.push_back(units.ids[(first + k) % units.size()]);
+			auto from = sim.map.getTilePos(units.pos[first]);
+			Math::Point2i to;
+			do {
+				to = Math::Point2i(
+					std::clamp<int>(from.x + rng() % (2 * ORDER_RANGE + 1) -
+							ORDER_RANGE, 0, sim.map.height - 1),
+					std::clamp<int>(from.y + rng() % (2 * ORDER_RANGE + 1) -
+							ORDER_RANGE, 0, sim.map.width - 1));
+			} while (!sim.map.canAquire(to));
+			sim.order(group, to);
+			n -= size;
+		}
+	}
+
+	/* the orders due this tick, the tick itself is left to the caller so it
+	can time it alone */
+	void orders() {
+		int due = int64_t(count) * (ticks + 1) / ORDER_TICKS - ordered;
+		giveOrders(due);
+		ordered += due;
+		ticks++;
+	}
+};
+
+#endif
\ No newline at end of file
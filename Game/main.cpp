@@ -138,7 +138,9 @@ int main (int argc, char const *argv[])
 
 		if (last_time != time(0)) {
 			last_time = time(0);
-			printf("time %d fps: %d\n", last_time, fps);
+			printf("time %d fps: %d tick: %.2fms render: %.2fms\n", last_time,
+					fps, newGame.sim.clock.tickMs,
+					newGame.sim.clock.renderMs);
 			fps = 0;
 		}
 
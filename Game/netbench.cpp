@@ -0,0 +1,146 @@
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+#include <algorithm>
+
+#include "Dbg.h"
+#include "Workload.h"
+#include "Replication.h"
+
+/* Headless replication bandwidth benchmark.
+	usage: ./netbench [ticks] [unit counts...]
+
+For every unit count (1000 10000 by default) the Workload of the server
+benchmark is run and every tick the units are sent to one client. The client
+acknowledges a tick ACK_DELAY ticks after it got it and one packet in LOSS is
+lost, so deltas are against older snapshots and a few keyframes are sent again.
+Each decoded snapshot is checked against the one of the server. The table gives
+the size of the first keyframe, the mean and 99th percentile delta, the rate
+at TICK_RATE ticks per second, the mean bits per unit of a delta, the time to
+encode and decode and the allocations made by them after WARMUP ticks. Exits
+with 1 if there were any allocations or mismatches. */
+
+const static int ACK_DELAY = 3;
+const static int LOSS = 50;
+const static int WARMUP = 2 * Replication::HISTORY;
+
+/* only the allocations of this thread, the workers of the PathService search
+while the packets are encoded */
+static thread_local long long allocations = 0;
+
+void *operator new (size_t size) {
+	allocations++;
+	if (void *ptr = malloc(size))
+		return ptr;
+	throw std::bad_alloc();
+}
+
+void operator delete (void *ptr) noexcept {
+	free(ptr);
+}
+
+void operator delete (void *ptr, size_t) noexcept {
+	free(ptr);
+}
+
+struct Row {
+	int units;
+	int keyframeBytes;
+	int keyframes;
+	double deltaBytes;
+	int deltaP99;
+	double kbits;
+	double bitsPerUnit;
+	double encodeUs;
+	double decodeUs;
+	long long allocs;
+	int mismatches;
+};
+
+Row run (int count, int ticks) {
+	Workload work(count);
+	ReplicationServer server;
+	ReplicationClient client;
+	std::vector<uint8_t> packet;
+	std::vector<int> deltas;
+	deltas.reserve(ticks);
+	uint32_t acks[ACK_DELAY + 1];
+	std::fill(acks, acks + ACK_DELAY + 1, UnitSnapshot::NONE);
+	std::mt19937 loss(2);
+
+	Row row{};
+	row.units = count;
+	double encodeTime = 0;
+	double decodeTime = 0;
+	for (int t = 0; t < ticks; t++) {
+		work.orders();
+		work.sim.tick();
+
+		/* the ack the client sent ACK_DELAY ticks ago */
+		uint32_t acked = acks[t % (ACK_DELAY + 1)];
+		bool steady = t >= WARMUP;
+		long long before = allocations;
+		double start = SimClock::now();
+		server.capture(work.sim.map, work.sim.units, t);
+		bool key = server.encode(acked, packet);
+		double mid = SimClock::now();
+		bool lost = loss() % LOSS == 0;
+		bool ok = lost || client.decode(packet.data(), packet.size());
+		double end = SimClock::now();
+		if (steady)
+			row.allocs += allocations - before;
+		encodeTime += mid - start;
+		decodeTime += end - mid;
+
+		if (!lost && ok && !(client.state() == *server.find(t)))
+			row.mismatches++;
+		acks[t % (ACK_DELAY + 1)] = ok ? client.latest : UnitSnapshot::NONE;
+		if (key) {
+			row.keyframes++;
+			if (!row.keyframeBytes)
+				row.keyframeBytes = packet.size();
+		}
+		else
+			deltas.push_back(packet.size());
+	}
+
+	double sum = 0;
+	for (auto&& bytes : deltas)
+		sum += bytes;
+	row.deltaBytes = deltas.size() ? sum / deltas.size() : 0;
+	row.bitsPerUnit = row.deltaBytes * 8 / count;
+	row.kbits = row.deltaBytes * 8 * SimClock::TICK_RATE / 1000;
+	std::sort(deltas.begin(), deltas.end());
+	if (deltas.size())
+		row.deltaP99 = deltas[std::min<size_t>(deltas.size() - 1,
+				deltas.size() * 0.99)];
+	row.encodeUs = encodeTime / ticks * 1e6;
+	row.decodeUs = decodeTime / ticks * 1e6;
+	return row;
+}
+
+int main (int argc, char const *argv[])
+{
+	int ticks = argc > 1 ? atoi(argv[1]) : 300;
+	std::vector<int> counts;
+	for (int i = 2; i < argc; i++)
+		counts.push_back(atoi(argv[i]));
+	if (counts.empty())
+		counts = {1000, 10000};
+
+	int failed = 0;
+	printf("%8s %9s %5s %9s %9s %9s %9s %9s %9s %7s %5s\n", "units",
+			"key B", "keys", "delta B", "p99 B", "kbit/s", "bit/unit",
+			"enc us", "dec us", "allocs", "bad");
+	for (auto&& count : counts) {
+		auto row = run(count, ticks);
+		printf("%8d %9d %5d %9.1f %9d %9.1f %9.2f %9.1f %9.1f %7lld %5d\n",
+				row.units, row.keyframeBytes, row.keyframes, row.deltaBytes,
+				row.deltaP99, row.kbits, row.bitsPerUnit, row.encodeUs,
+				row.decodeUs, row.allocs, row.mismatches);
+		fflush(stdout);
+		failed |= row.allocs > 0 || row.mismatches > 0;
+	}
+	return failed;
+}
\ No newline at end of file
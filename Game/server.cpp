@@ -0,0 +1,98 @@
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include <thread>
+#include <algorithm>
+
+#include "Dbg.h"
+#include "Workload.h"
+
+/* Headless server benchmark, no window and no GL context.
+	usage: ./server [ticks] [threads] [unit counts...]
+
+For every unit count (1000 10000 100000 by default) the Workload is run with
+threads moving the units and one less searching paths, as many as the machine
+has for 0. Ticks 0 or missing runs DEFAULT_TICKS ticks, BIG_TICKS from
+BIG_UNITS units on. Each tick is timed, the table gives the ticks per second,
+the median, 99th percentile and worst tick time and the resident memory after
+the run. Run it with a few thread counts to size the hardware of a server. */
+
+const static int DEFAULT_TICKS = 100;
+const static int BIG_TICKS = 10;
+const static int BIG_UNITS = 100000;
+
+struct Row {
+	int units;
+	int threads;
+	int side;
+	int ticks;
+	double ticksPerSecond;
+	double p50;
+	double p99;
+	double maxMs;
+	double memoryMb;
+};
+
+/* resident memory in MB, 0 where /proc is missing */
+double residentMb() {
+	FILE *status = fopen("/proc/self/status", "r");
+	if (!status)
+		return 0;
+	char line[256];
+	double kb = 0;
+	while (fgets(line, sizeof(line), status))
+		if (sscanf(line, "VmRSS: %lf", &kb) == 1)
+			break ;
+	fclose(status);
+	return kb / 1024;
+}
+
+Row run (int count, int ticks, int threads) {
+	Workload work(count, threads);
+	std::vector<double> times;
+	double total = 0;
+	for (int t = 0; t < ticks; t++) {
+		work.orders();
+		double start = SimClock::now();
+		work.sim.tick();
+		double ms = (SimClock::now() - start) * 1000;
+		times.push_back(ms);
+		total += ms;
+	}
+	std::sort(times.begin(), times.end());
+	auto at = [&] (double q) {
+		return times[std::min<size_t>(times.size() - 1, times.size() * q)];
+	};
+	return Row{count, threads, Workload::side(count), ticks,
+			ticks / (total / 1000),
+			at(0.5), at(0.99), times.back(), residentMb()};
+}
+
+int main (int argc, char const *argv[])
+{
+	int ticks = argc > 1 ? atoi(argv[1]) : 0;
+	int threads = argc > 2 ? atoi(argv[2]) : 0;
+	if (threads <= 0)
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	std::vector<int> counts;
+	for (int i = 3; i < argc; i++)
+		counts.push_back(atoi(argv[i]));
+	if (counts.empty())
+		counts = {1000, 10000, 100000};
+
+	printf("%8s %7s %6s %6s %10s %9s %9s %9s %9s\n", "units", "threads",
+			"map", "ticks", "ticks/s", "p50 ms", "p99 ms", "max ms", "rss MB");
+	for (auto&& count : counts) {
+		int n = ticks > 0 ? ticks :
+				count >= BIG_UNITS ? BIG_TICKS : DEFAULT_TICKS;
+		auto row = run(count, n, threads);
+		printf("%8d %7d %6d %6d %10.1f %9.2f %9.2f %9.2f %9.1f\n",
+				row.units, row.threads, row.side, row.ticks,
+				row.ticksPerSecond, row.p50, row.p99, row.maxMs,
+				row.memoryMb);
+		fflush(stdout);
+	}
+	return 0;
+}
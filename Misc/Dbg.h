@@ -0,0 +1,13 @@
+#ifndef DBG_H_INCLUDED
+#define DBG_H_INCLUDED
+
+#include <cstdio>
+
+/* DBG the way Util.h defines it, for the programs that are built without the
+GL headers Util.h includes */
+#ifndef DBG
+#define DBG(fmt, ...) printf("[%s:%d] %s() :> " fmt "\n",\
+        __FILE__, __LINE__, __func__, ##__VA_ARGS__);
+#endif
+
+#endif
\ No newline at end of file